@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "arena.h"
+
+/* Every returned address is aligned so that any type can be stored there. */
+#define ARENA_ALIGN 16
+
+static size_t align_up(size_t size) {
+  return (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+}
+
+/* Bytes needed to bring the next free address in block up to ARENA_ALIGN. */
+static size_t block_padding(arena_block_t* block) {
+  uintptr_t next = (uintptr_t) (block->data + block->used);
+  return (size_t) (align_up(next) - next);
+}
+
+static arena_block_t* block_create(size_t size) {
+  arena_block_t* block = malloc(sizeof(arena_block_t) + size);
+  if (block == NULL) {
+    return NULL;
+  }
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+arena_t* arena_create(size_t capacity) {
+  arena_t* arena = malloc(sizeof(arena_t));
+  if (arena == NULL) {
+    return NULL;
+  }
+  arena->first = block_create(align_up(capacity) + ARENA_ALIGN);
+  if (arena->first == NULL) {
+    free(arena);
+    return NULL;
+  }
+  arena->head = arena->first;
+  return arena;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+  size = align_up(size);
+  arena_block_t* block = arena->head;
+  if (block->size - block->used < size + block_padding(block)) {
+    // Out of room: chain on a block at least as big as the current one
+    size_t next_size = block->size * 2;
+    if (next_size < size + ARENA_ALIGN) {
+      next_size = size + ARENA_ALIGN;
+    }
+    block = block_create(next_size);
+    if (block == NULL) {
+      return NULL;
+    }
+    arena->head->next = block;
+    arena->head = block;
+  }
+  block->used += block_padding(block);
+  void* ptr = block->data + block->used;
+  block->used += size;
+  return ptr;
+}
+
+void arena_reset(arena_t* arena) {
+  arena_block_t* block = arena->first->next;
+  while (block != NULL) {
+    arena_block_t* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->first->next = NULL;
+  arena->first->used = 0;
+  arena->head = arena->first;
+}
+
+void arena_destroy(arena_t* arena) {
+  arena_reset(arena);
+  free(arena->first);
+  free(arena);
+}
@@ -0,0 +1,29 @@
+#ifndef _SNK_ARENA_H
+#define _SNK_ARENA_H
+
+#include <stddef.h>
+
+/*
+  A bump allocator. Every allocation comes out of one region and is released all at once by
+  arena_reset, so a state built in an arena costs a handful of pointer bumps instead of one malloc
+  per row. If the first region fills up, further regions are chained on; arena_reset keeps only the
+  first one, so an arena that is sized correctly up front never touches malloc again.
+*/
+typedef struct arena_block_t {
+  struct arena_block_t* next;
+  size_t size;
+  size_t used;
+  char data[];
+} arena_block_t;
+
+typedef struct arena_t {
+  arena_block_t* head;
+  arena_block_t* first;
+} arena_t;
+
+arena_t* arena_create(size_t capacity);
+void* arena_alloc(arena_t* arena, size_t size);
+void arena_reset(arena_t* arena);
+void arena_destroy(arena_t* arena);
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <string.h>
+#include "autopilot.h"
+
+#define FLAG_DIRTY 1
+#define FLAG_INVALID 2
+
+// Past this many changed cells, recomputing the whole field is cheaper than repairing it
+#define REBUILD_FRACTION 8
+
+static const int dx[] = {0, -1, 0, 1};
+static const int dy[] = {-1, 0, 1, 0};
+static const char heads[] = "^<v>";
+
+static bool passable(char c) {
+  return c == ' ' || c == '*';
+}
+
+static char cell_at(autopilot_t* autopilot, uint32_t cell) {
+  return get_board_at(autopilot->state, cell % autopilot->x_size, cell / autopilot->x_size);
+}
+
+/* Stores the cell next to cell in direction dir in *next. Returns false at the edge of the board. */
+static bool neighbor(autopilot_t* autopilot, uint32_t cell, int dir, uint32_t* next) {
+  unsigned int x = cell % autopilot->x_size;
+  unsigned int y = cell / autopilot->x_size;
+  if ((dx[dir] < 0 && x == 0) || (dx[dir] > 0 && x == autopilot->x_size - 1) || (dy[dir] < 0 && y == 0)
+      || (dy[dir] > 0 && y == autopilot->y_size - 1)) {
+    return false;
+  }
+  *next = (y + dy[dir]) * autopilot->x_size + x + dx[dir];
+  return true;
+}
+
+static void watch_cell(game_state_t* state, int x, int y, char old_ch, char new_ch, void* ctx) {
+  // Snakes turning or growing don't change where anything can go
+  if (passable(old_ch) == passable(new_ch) && (old_ch == '*') == (new_ch == '*')) {
+    return;
+  }
+  autopilot_t* autopilot = ctx;
+  uint32_t cell = y * autopilot->x_size + x;
+  if (!(autopilot->flags[cell] & FLAG_DIRTY)) {
+    autopilot->flags[cell] |= FLAG_DIRTY;
+    autopilot->dirty[autopilot->num_dirty] = cell;
+    autopilot->num_dirty += 1;
+  }
+}
+
+/*
+  Lowers distances outwards from the cells in seeds (sorted by distance) and the first tail cells
+  of the queue, in order of increasing distance. Each cell is queued at most once.
+*/
+static void propagate(autopilot_t* autopilot, uint32_t* seeds, size_t num_seeds, size_t tail) {
+  uint32_t* dist = autopilot->dist;
+  size_t head = 0;
+  size_t next_seed = 0;
+  while (head < tail || next_seed < num_seeds) {
+    uint32_t cell;
+    if (next_seed < num_seeds && (head == tail || dist[seeds[next_seed]] <= dist[autopilot->queue[head]])) {
+      cell = seeds[next_seed];
+      next_seed += 1;
+    } else {
+      cell = autopilot->queue[head];
+      head += 1;
+    }
+    if (dist[cell] == AUTOPILOT_FAR) {
+      continue;
+    }
+    for (int dir = 0; dir < 4; dir++) {
+      uint32_t next;
+      if (neighbor(autopilot, cell, dir, &next) && dist[cell] + 1 < dist[next] && passable(cell_at(autopilot, next))) {
+        dist[next] = dist[cell] + 1;
+        autopilot->queue[tail] = next;
+        tail += 1;
+      }
+    }
+  }
+}
+
+/* Recomputes the whole field with a breadth-first search from every food cell. */
+static void rebuild(autopilot_t* autopilot) {
+  size_t cells = (size_t) autopilot->x_size * autopilot->y_size;
+  size_t tail = 0;
+  for (uint32_t cell = 0; cell < cells; cell++) {
+    autopilot->flags[cell] = 0;
+    if (cell_at(autopilot, cell) == '*') {
+      autopilot->dist[cell] = 0;
+      autopilot->queue[tail] = cell;
+      tail += 1;
+    } else {
+      autopilot->dist[cell] = AUTOPILOT_FAR;
+    }
+  }
+  autopilot->num_dirty = 0;
+  propagate(autopilot, NULL, 0, tail);
+  autopilot->rebuilds += 1;
+}
+
+/* True if cell still has a neighbor that is one step closer to food and isn't being recomputed. */
+static bool supported(autopilot_t* autopilot, uint32_t cell) {
+  uint32_t d = autopilot->dist[cell];
+  if (d == 0) {
+    return true;
+  }
+  for (int dir = 0; dir < 4; dir++) {
+    uint32_t next;
+    if (neighbor(autopilot, cell, dir, &next) && !(autopilot->flags[next] & FLAG_INVALID)
+        && autopilot->dist[next] == d - 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Sorts cells by distance with a radix sort, using the queue as scratch space. */
+static void sort_by_dist(autopilot_t* autopilot, uint32_t* cells, size_t count) {
+  uint32_t* scratch = autopilot->queue;
+  for (int shift = 0; shift < 32; shift += 8) {
+    size_t offsets[257] = {0};
+    for (size_t i = 0; i < count; i++) {
+      offsets[((autopilot->dist[cells[i]] >> shift) & 0xFF) + 1] += 1;
+    }
+    for (int b = 0; b < 256; b++) {
+      offsets[b + 1] += offsets[b];
+    }
+    for (size_t i = 0; i < count; i++) {
+      scratch[offsets[(autopilot->dist[cells[i]] >> shift) & 0xFF]++] = cells[i];
+    }
+    memcpy(cells, scratch, count * sizeof(uint32_t));
+  }
+}
+
+/* Brings the distance field up to date with every board change since the last update. */
+void autopilot_update(autopilot_t* autopilot) {
+  if (autopilot->num_dirty == 0) {
+    return;
+  }
+  size_t cells = (size_t) autopilot->x_size * autopilot->y_size;
+  if (autopilot->num_dirty > cells / REBUILD_FRACTION) {
+    rebuild(autopilot);
+    return;
+  }
+  uint32_t* dist = autopilot->dist;
+  uint8_t* flags = autopilot->flags;
+
+  // Every changed cell has to be recomputed, and so does every cell whose only way to food went
+  // through a cell that is being recomputed
+  size_t num_invalid = 0;
+  for (size_t i = 0; i < autopilot->num_dirty; i++) {
+    uint32_t cell = autopilot->dirty[i];
+    flags[cell] = FLAG_INVALID;
+    autopilot->invalid[num_invalid] = cell;
+    num_invalid += 1;
+  }
+  autopilot->num_dirty = 0;
+  for (size_t i = 0; i < num_invalid; i++) {
+    uint32_t cell = autopilot->invalid[i];
+    if (dist[cell] == AUTOPILOT_FAR) {
+      continue;
+    }
+    for (int dir = 0; dir < 4; dir++) {
+      uint32_t next;
+      if (neighbor(autopilot, cell, dir, &next) && !(flags[next] & FLAG_INVALID) && dist[next] == dist[cell] + 1
+          && !supported(autopilot, next)) {
+        flags[next] = FLAG_INVALID;
+        autopilot->invalid[num_invalid] = next;
+        num_invalid += 1;
+      }
+    }
+  }
+
+  // Start each recomputed cell from its best neighbor that kept its distance...
+  for (size_t i = 0; i < num_invalid; i++) {
+    uint32_t cell = autopilot->invalid[i];
+    char c = cell_at(autopilot, cell);
+    uint32_t best = AUTOPILOT_FAR;
+    if (c == '*') {
+      best = 0;
+    } else if (passable(c)) {
+      for (int dir = 0; dir < 4; dir++) {
+        uint32_t next;
+        if (neighbor(autopilot, cell, dir, &next) && !(flags[next] & FLAG_INVALID) && dist[next] != AUTOPILOT_FAR
+            && dist[next] + 1 < best) {
+          best = dist[next] + 1;
+        }
+      }
+    }
+    dist[cell] = best;
+  }
+  for (size_t i = 0; i < num_invalid; i++) {
+    flags[autopilot->invalid[i]] = 0;
+  }
+
+  // ...then let shorter distances spread out from them
+  sort_by_dist(autopilot, autopilot->invalid, num_invalid);
+  propagate(autopilot, autopilot->invalid, num_invalid, 0);
+  autopilot->repairs += 1;
+}
+
+/* Attaches an autopilot to state. Returns NULL if state has no free watcher slot. */
+autopilot_t* autopilot_create(game_state_t* state) {
+  autopilot_t* autopilot = calloc(1, sizeof(autopilot_t));
+  size_t cells = (size_t) state->x_size * state->y_size;
+  autopilot->state = state;
+  autopilot->x_size = state->x_size;
+  autopilot->y_size = state->y_size;
+  autopilot->dist = malloc(cells * sizeof(uint32_t));
+  autopilot->dirty = malloc(cells * sizeof(uint32_t));
+  autopilot->flags = malloc(cells);
+  autopilot->invalid = malloc(cells * sizeof(uint32_t));
+  autopilot->queue = malloc(cells * sizeof(uint32_t));
+  if (!watch_board(state, watch_cell, autopilot)) {
+    autopilot->state = NULL;
+    autopilot_destroy(autopilot);
+    return NULL;
+  }
+  rebuild(autopilot);
+  return autopilot;
+}
+
+void autopilot_destroy(autopilot_t* autopilot) {
+  if (autopilot->state != NULL) {
+    unwatch_board(autopilot->state, watch_cell, autopilot);
+  }
+  free(autopilot->dist);
+  free(autopilot->dirty);
+  free(autopilot->flags);
+  free(autopilot->invalid);
+  free(autopilot->queue);
+  free(autopilot);
+}
+
+/*
+  Points snake snum at the free neighboring cell closest to food, going straight on ties. If no
+  food can be reached it still turns away from walls. Call autopilot_update first.
+*/
+void autopilot_steer(autopilot_t* autopilot, int snum) {
+  snake_t* snake = &autopilot->state->snakes[snum];
+  if (!snake->live) {
+    return;
+  }
+  uint32_t head = snake->head_y * autopilot->x_size + snake->head_x;
+  const char* cur = strchr(heads, cell_at(autopilot, head));
+  if (cur == NULL) {
+    return;
+  }
+  int cur_dir = cur - heads;
+  int best_dir = -1;
+  uint32_t best_dist = AUTOPILOT_FAR;
+  // Straight ahead first, then left and right; turning back would always hit the snake's own body
+  int order[] = {cur_dir, (cur_dir + 1) % 4, (cur_dir + 3) % 4};
+  for (int i = 0; i < 3; i++) {
+    uint32_t next;
+    if (!neighbor(autopilot, head, order[i], &next) || !passable(cell_at(autopilot, next))) {
+      continue;
+    }
+    if (best_dir < 0 || autopilot->dist[next] < best_dist) {
+      best_dir = order[i];
+      best_dist = autopilot->dist[next];
+    }
+  }
+  if (best_dir >= 0 && best_dir != cur_dir) {
+    set_board_at(autopilot->state, snake->head_x, snake->head_y, heads[best_dir]);
+  }
+}
+
+/* Steers every live snake. Has the signature of a sim_steer_t, with the autopilot as its context. */
+void autopilot_steer_all(game_state_t* state, void* ctx) {
+  autopilot_t* autopilot = ctx;
+  autopilot_update(autopilot);
+  for (unsigned int j = 0; j < state->num_live; j++) {
+    autopilot_steer(autopilot, state->live_snakes[j]);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef _SNK_AUTOPILOT_H
+#define _SNK_AUTOPILOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "state.h"
+
+#define AUTOPILOT_FAR UINT32_MAX
+
+/*
+  Steers snakes towards the nearest food using a distance field: for every free cell, the length
+  of the shortest path to any food. The field is built once with a breadth-first search, and after
+  that only repaired around the cells that changed, which a board watcher records as the game runs.
+  All buffers are allocated up front and reused, so steering hundreds of snakes costs one repair
+  per tick plus four lookups per snake.
+*/
+typedef struct autopilot_t {
+  game_state_t* state;
+  unsigned int x_size;
+  unsigned int y_size;
+
+  // Distance from each cell to the nearest food, or AUTOPILOT_FAR if blocked or out of reach
+  uint32_t* dist;
+
+  // Cells whose passability or food changed since the last repair
+  uint32_t* dirty;
+  size_t num_dirty;
+
+  // Scratch space for repairs: per-cell flags, the cells whose distance is being recomputed, and a
+  // breadth-first queue
+  uint8_t* flags;
+  uint32_t* invalid;
+  uint32_t* queue;
+
+  unsigned long repairs;
+  unsigned long rebuilds;
+} autopilot_t;
+
+autopilot_t* autopilot_create(game_state_t* state);
+void autopilot_destroy(autopilot_t* autopilot);
+void autopilot_update(autopilot_t* autopilot);
+void autopilot_steer(autopilot_t* autopilot, int snum);
+void autopilot_steer_all(game_state_t* state, void* autopilot);
+
+#endif
@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "fixed_engine.h"
+#include "snake_utils.h"
+#include "state.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+/*
+  Benchmark driver: times load_board and update_state (and the fixed-size engine, when the board
+  has one of its shapes, or on a huge sparse world instead) with wall-clock time and, where the kernel allows it, hardware performance
+  counters read through perf_event_open. Counters that can't be opened (no PMU,
+  perf_event_paranoid, non-Linux) are reported as unavailable.
+*/
+
+typedef struct counter_t {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+  int fd;
+  uint64_t total;
+} counter_t;
+
+#ifdef __linux__
+#define CACHE_CONFIG(cache, op, result) \
+  ((cache) | ((op) << 8) | ((result) << 16))
+
+counter_t counters[] = {
+  {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0},
+  {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0},
+  {"l1d-misses", PERF_TYPE_HW_CACHE,
+   CACHE_CONFIG(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), -1, 0},
+  {"llc-misses", PERF_TYPE_HW_CACHE,
+   CACHE_CONFIG(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), -1, 0},
+  {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0},
+};
+#else
+counter_t counters[] = {
+  {"cycles", 0, 0, -1, 0},
+  {"instructions", 0, 0, -1, 0},
+  {"l1d-misses", 0, 0, -1, 0},
+  {"llc-misses", 0, 0, -1, 0},
+  {"branch-misses", 0, 0, -1, 0},
+};
+#endif
+
+#define NUM_COUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+double wall_total = 0;
+struct timespec wall_start;
+
+void counters_open() {
+#ifdef __linux__
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counters[i].type;
+    attr.config = counters[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    counters[i].fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counters[i].fd < 0) {
+      fprintf(stderr, "Counter %s unavailable: %s\n", counters[i].name, strerror(errno));
+    }
+  }
+#else
+  fprintf(stderr, "Hardware counters unavailable on this platform\n");
+#endif
+}
+
+void counters_close() {
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counters[i].fd >= 0) {
+      close(counters[i].fd);
+      counters[i].fd = -1;
+    }
+  }
+}
+
+void counters_reset() {
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    counters[i].total = 0;
+#ifdef __linux__
+    if (counters[i].fd >= 0) {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+    }
+#endif
+  }
+  wall_total = 0;
+}
+
+/* Starts counting. Counters accumulate across start/stop pairs until counters_reset. */
+void counters_start() {
+#ifdef __linux__
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counters[i].fd >= 0) {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+}
+
+void counters_stop() {
+  struct timespec wall_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+#ifdef __linux__
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counters[i].fd >= 0) {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+#endif
+  wall_total += (wall_end.tv_sec - wall_start.tv_sec) * 1e9 + (wall_end.tv_nsec - wall_start.tv_nsec);
+}
+
+void counters_read() {
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    uint64_t value = 0;
+    if (counters[i].fd >= 0 && read(counters[i].fd, &value, sizeof(value)) == sizeof(value)) {
+      counters[i].total = value;
+    }
+  }
+}
+
+void report(const char* label, double units, const char* unit_name, double cells) {
+  counters_read();
+  printf("%s: %.0f %s\n", label, units, unit_name);
+  printf("  %-14s %14.1f per %s %12.3f per cell\n", "wall-ns", wall_total / units, unit_name,
+         wall_total / units / cells);
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counters[i].fd < 0) {
+      printf("  %-14s %14s\n", counters[i].name, "unavailable");
+    } else {
+      printf("  %-14s %14.1f per %s %12.3f per cell\n", counters[i].name, counters[i].total / units, unit_name,
+             counters[i].total / units / cells);
+    }
+  }
+}
+
+// With -w and -h, the benchmarks run on an empty sparse world of that size with -s snakes
+unsigned int world_width = 0;
+unsigned int world_height = 0;
+unsigned int world_snakes = 1000;
+
+/* Builds the sparse world: short snakes heading in random directions, each with food nearby. */
+game_state_t* sparse_world() {
+  static const char* tails = "wasd";
+  static const char* heads = "^<v>";
+  static const int dx[] = {0, -1, 0, 1};
+  static const int dy[] = {-1, 0, 1, 0};
+  uint32_t world_seed = 1;
+  game_state_t* state = create_sparse_state(world_width, world_height);
+  for (unsigned int i = 0; i < world_snakes; i++) {
+    // Keep clear of the wall so every snake fits
+    unsigned int x = 10 + det_rand(&world_seed) % (world_width - 20);
+    unsigned int y = 10 + det_rand(&world_seed) % (world_height - 20);
+    int dir = det_rand(&world_seed) % 4;
+    if (get_board_at(state, x, y) != ' ' || get_board_at(state, x + dx[dir], y + dy[dir]) != ' ') {
+      continue;
+    }
+    set_board_at(state, x, y, tails[dir]);
+    set_board_at(state, x + dx[dir], y + dy[dir], heads[dir]);
+    if (get_board_at(state, x + 5 * dx[dir], y + 5 * dy[dir]) == ' ') {
+      set_board_at(state, x + 5 * dx[dir], y + 5 * dy[dir], '*');
+    }
+  }
+  return initialize_snakes(state);
+}
+
+game_state_t* fresh_state(char* in_filename) {
+  if (world_width > 0) {
+    return sparse_world();
+  }
+  if (in_filename == NULL) {
+    return create_default_state();
+  }
+  game_state_t* state = load_board(in_filename);
+  if (state == NULL) {
+    exit(1);
+  }
+  return initialize_snakes(state);
+}
+
+/* Same as fresh_state, but gives up if no snake on the board is alive, since it could never tick. */
+game_state_t* live_state(char* in_filename) {
+  game_state_t* state = fresh_state(in_filename);
+  if (state->num_live == 0) {
+    fprintf(stderr, "%s: no live snakes to tick\n", in_filename != NULL ? in_filename : "board");
+    exit(1);
+  }
+  return state;
+}
+
+/*
+  Times ticks calls to update. Whenever every snake has died, starts over from a freshly loaded
+  board; reloading happens with the counters stopped.
+*/
+void run_ticks(const char* label, update_fn_t update, char* in_filename, unsigned long ticks, double cells) {
+  counters_reset();
+  game_state_t* state = live_state(in_filename);
+  unsigned long tick = 0;
+  while (tick < ticks) {
+    if (state->num_live == 0) {
+      free_state(state);
+      state = live_state(in_filename);
+    }
+    counters_start();
+    while (tick < ticks && state->num_live > 0) {
+      update(state, deterministic_food);
+      tick += 1;
+    }
+    counters_stop();
+  }
+  report(label, ticks, "tick", cells);
+  free_state(state);
+}
+
+int main(int argc, char* argv[]) {
+  char* in_filename = NULL;
+  unsigned long ticks = 100000;
+  unsigned long loads = 100;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-i") == 0 && i < argc - 1) {
+      in_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-n") == 0 && i < argc - 1) {
+      ticks = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-l") == 0 && i < argc - 1) {
+      loads = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-w") == 0 && i < argc - 1) {
+      world_width = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-h") == 0 && i < argc - 1) {
+      world_height = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-s") == 0 && i < argc - 1) {
+      world_snakes = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s [-i filename] [-n ticks] [-l loads] [-w width -h height [-s snakes]]\n", argv[0]);
+    return 1;
+  }
+  if ((world_width > 0) != (world_height > 0) || (world_width > 0 && (world_width < 32 || world_height < 32))) {
+    fprintf(stderr, "A sparse world needs both -w and -h, each at least 32\n");
+    return 1;
+  }
+  if (loads == 0) {
+    fprintf(stderr, "-l must be at least 1\n");
+    return 1;
+  }
+  // The board is loaded over and over, which a pipe can't do
+  if (in_filename != NULL && strcmp(in_filename, "-") == 0) {
+    fprintf(stderr, "snake-bench needs a file it can reload, not stdin\n");
+    return 1;
+  }
+
+  counters_open();
+
+  // load_board (with initialize_snakes), only when a file was given
+  game_state_t* initial = NULL;
+  if (world_width > 0) {
+    initial = sparse_world();
+    printf("sparse world: %ux%u, %u snakes, %zu chunks, %.1f MB\n", world_width, world_height, initial->num_snakes,
+           initial->sparse->num_chunks, sparse_board_bytes(initial->sparse) / 1e6);
+  } else if (in_filename != NULL) {
+    counters_reset();
+    for (unsigned long i = 0; i < loads; i++) {
+      counters_start();
+      game_state_t* state = load_board(in_filename);
+      if (state == NULL) {
+        return 1;
+      }
+      initialize_snakes(state);
+      counters_stop();
+      if (initial == NULL) {
+        initial = state;
+      } else {
+        free_state(state);
+      }
+    }
+    report("load_board", loads, "load", (double) initial->x_size * initial->y_size);
+  } else {
+    initial = create_default_state();
+  }
+  double cells = (double) initial->x_size * initial->y_size;
+
+  run_ticks("update_state", update_state, in_filename, ticks, cells);
+  update_fn_t fixed = fixed_engine_for(initial);
+  if (fixed != update_state) {
+    run_ticks("fixed_update_state", fixed, in_filename, ticks, cells);
+  }
+
+  free_state(initial);
+  counters_close();
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include "board_check.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const bool board_chars[256] = {
+  [' '] = true, ['#'] = true, ['*'] = true,
+  ['^'] = true, ['<'] = true, ['>'] = true, ['v'] = true, ['x'] = true,
+  ['w'] = true, ['a'] = true, ['s'] = true, ['d'] = true,
+};
+
+#if defined(__SSE2__)
+/* Bit i is set if byte i of block is in the board alphabet. */
+static unsigned int board_char_mask(__m128i block) {
+  __m128i ok = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('#')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('*')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('^')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('<')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('>')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('v')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('x')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('w')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('a')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('s')));
+  ok = _mm_or_si128(ok, _mm_cmpeq_epi8(block, _mm_set1_epi8('d')));
+  return (unsigned int) _mm_movemask_epi8(ok);
+}
+#endif
+
+/* Index of the first byte of bytes[0, len) that isn't c, or len if they all are. */
+static size_t first_other(const char* bytes, size_t len, char c) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  __m128i wanted = _mm_set1_epi8(c);
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*) (bytes + i));
+    unsigned int other = ~(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block, wanted)) & 0xFFFF;
+    if (other != 0) {
+      return i + __builtin_ctz(other);
+    }
+  }
+#endif
+  while (i < len && bytes[i] == c) {
+    i++;
+  }
+  return i;
+}
+
+/* Index of the first byte of bytes[0, len) that can't appear on a board, or len if there is none. */
+size_t board_check_chars(const char* bytes, size_t len) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= len; i += 16) {
+    unsigned int bad = ~board_char_mask(_mm_loadu_si128((const __m128i*) (bytes + i))) & 0xFFFF;
+    if (bad != 0) {
+      return i + __builtin_ctz(bad);
+    }
+  }
+#endif
+  while (i < len && board_chars[(unsigned char) bytes[i]]) {
+    i++;
+  }
+  return i;
+}
+
+/* Index of the first byte of bytes[0, len) that isn't a wall, or len if there is none. */
+size_t board_check_walls(const char* bytes, size_t len) {
+  return first_other(bytes, len, '#');
+}
+
+/* Index of the first byte of bytes[0, len) that isn't an empty cell, or len if there is none. */
+size_t board_next_cell(const char* bytes, size_t len) {
+  return first_other(bytes, len, ' ');
+}
+
+/*
+  Checks one row of a board whose first row is x_size wide. row holds len bytes, without the
+  newline; edge says it is the first or last row, which must be wall all the way across. Returns
+  the first problem in the row and sets col to where it is, or returns NULL if there is none.
+*/
+const char* board_check_row(const char* row, size_t len, size_t x_size, bool edge, size_t* col) {
+  size_t n = len < x_size ? len : x_size;
+  size_t bad = board_check_chars(row, n);
+  size_t gap = n;
+  if (edge) {
+    gap = board_check_walls(row, n);
+  } else if (n > 0 && row[0] != '#') {
+    gap = 0;
+  } else if (len >= x_size && x_size > 0 && row[x_size - 1] != '#') {
+    gap = x_size - 1;
+  }
+
+  // Whichever problem comes first in the row is reported, and a bad character over a missing wall
+  if (bad < n && bad <= gap) {
+    *col = bad;
+    return "unexpected character";
+  }
+  if (gap < n) {
+    *col = gap;
+    return "border is not a wall";
+  }
+  if (len != x_size) {
+    *col = n;
+    return len < x_size ? "row is shorter than the first row" : "row is longer than the first row";
+  }
+  return NULL;
+}
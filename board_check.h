@@ -0,0 +1,20 @@
+#ifndef _SNK_BOARD_CHECK_H
+#define _SNK_BOARD_CHECK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+  Validation of board rows as they are loaded, so boards from anywhere can be trusted once they
+  load. A board is a rectangle of characters from the board alphabet (wall, space, food, snake
+  bodies and heads, tails and dead heads) whose border is all wall; the border is what keeps a
+  snake that runs off the edge from walking out of the board. Bytes are classified 16 at a time
+  with SSE2 where the compiler targets it, and one at a time with a table otherwise.
+*/
+
+size_t board_check_chars(const char* bytes, size_t len);
+size_t board_check_walls(const char* bytes, size_t len);
+size_t board_next_cell(const char* bytes, size_t len);
+const char* board_check_row(const char* row, size_t len, size_t x_size, bool edge, size_t* col);
+
+#endif
@@ -0,0 +1,52 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board_map.h"
+
+/* Maps filename with one reference. Returns NULL (after printing why) if it can't be mapped. */
+board_map_t* board_map_open(const char* filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size == 0) {
+    fprintf(stderr, "%s:1:1: board is empty\n", filename);
+    close(fd);
+    return NULL;
+  }
+  void* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return NULL;
+  }
+  board_map_t* map = malloc(sizeof(board_map_t));
+  map->base = base;
+  map->len = st.st_size;
+  map->refs = 1;
+  return map;
+}
+
+/* Drops one reference to map, unmapping it once nothing uses it. */
+void board_map_release(board_map_t* map) {
+  map->refs -= 1;
+  if (map->refs == 0) {
+    munmap(map->base, map->len);
+    free(map);
+  }
+}
@@ -0,0 +1,20 @@
+#ifndef _SNK_BOARD_MAP_H
+#define _SNK_BOARD_MAP_H
+
+#include <stddef.h>
+
+/*
+  A private, writable mapping of a board file. Writes stay in this process (the kernel copies each
+  page the first time it is written), so the file itself never changes. The mapping is shared by a
+  mapped state and all of its clones, and unmapped when the last of them is freed.
+*/
+typedef struct board_map_t {
+  char* base;
+  size_t len;
+  unsigned int refs;
+} board_map_t;
+
+board_map_t* board_map_open(const char* filename);
+void board_map_release(board_map_t* map);
+
+#endif
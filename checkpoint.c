@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+/* Writes snapshot to checkpoint->filename through the temporary file. Returns 0 or an errno. */
+static int write_snapshot(checkpoint_t* checkpoint, game_state_t* snapshot) {
+  FILE* f = fopen(checkpoint->tmp_filename, "w");
+  if (f == NULL) {
+    return errno;
+  }
+  // Not print_board: its phase statistics belong to the game's thread
+  for (unsigned int y = 0; y < snapshot->y_size; y++) {
+    fwrite(snapshot->board[y], 1, snapshot->x_size + 1, f);
+  }
+  int error = 0;
+  if (fflush(f) != 0 || fsync(fileno(f)) != 0) {
+    error = errno;
+  }
+  if (fclose(f) != 0 && error == 0) {
+    error = errno;
+  }
+  if (error == 0 && rename(checkpoint->tmp_filename, checkpoint->filename) != 0) {
+    error = errno;
+  }
+  return error;
+}
+
+static void* writer_loop(void* arg) {
+  checkpoint_t* checkpoint = arg;
+  pthread_mutex_lock(&checkpoint->lock);
+  while (true) {
+    while (checkpoint->pending == NULL && !checkpoint->stopping) {
+      pthread_cond_wait(&checkpoint->wake, &checkpoint->lock);
+    }
+    if (checkpoint->pending == NULL) {
+      break;
+    }
+    checkpoint->writing = checkpoint->pending;
+    checkpoint->pending = NULL;
+    pthread_mutex_unlock(&checkpoint->lock);
+
+    int error = write_snapshot(checkpoint, checkpoint->writing);
+
+    pthread_mutex_lock(&checkpoint->lock);
+    if (error != 0 && checkpoint->error == 0) {
+      checkpoint->error = error;
+    }
+    if (error == 0) {
+      checkpoint->written += 1;
+    }
+    checkpoint->done[checkpoint->num_done] = checkpoint->writing;
+    checkpoint->num_done += 1;
+    checkpoint->writing = NULL;
+  }
+  pthread_mutex_unlock(&checkpoint->lock);
+  return NULL;
+}
+
+/* Starts a writer thread for checkpoints of one game, saved to filename. */
+checkpoint_t* checkpoint_create(const char* filename) {
+  checkpoint_t* checkpoint = calloc(1, sizeof(checkpoint_t));
+  checkpoint->filename = strdup(filename);
+  checkpoint->tmp_filename = malloc(strlen(filename) + 5);
+  strcpy(checkpoint->tmp_filename, filename);
+  strcat(checkpoint->tmp_filename, ".tmp");
+  pthread_mutex_init(&checkpoint->lock, NULL);
+  pthread_cond_init(&checkpoint->wake, NULL);
+  pthread_create(&checkpoint->thread, NULL, writer_loop, checkpoint);
+  return checkpoint;
+}
+
+/*
+  Queues a snapshot of state to be written. Never waits for the disk. Must always be called from
+  the thread that runs the game, and state must not be allocated from an arena (clones of it
+  would never be freed). Sparse states have no rows to write, so they fail with EINVAL.
+*/
+void checkpoint_save(checkpoint_t* checkpoint, game_state_t* state) {
+  if (state->sparse != NULL) {
+    pthread_mutex_lock(&checkpoint->lock);
+    if (checkpoint->error == 0) {
+      checkpoint->error = EINVAL;
+    }
+    pthread_mutex_unlock(&checkpoint->lock);
+    return;
+  }
+
+  // Cloning touches row reference counts, which the writer never reads, so it needs no lock
+  game_state_t* snapshot = clone_state(state);
+
+  pthread_mutex_lock(&checkpoint->lock);
+  game_state_t* done[2];
+  unsigned int num_done = checkpoint->num_done;
+  memcpy(done, checkpoint->done, sizeof(done));
+  checkpoint->num_done = 0;
+  game_state_t* dropped = checkpoint->pending;
+  checkpoint->pending = snapshot;
+  checkpoint->saved += 1;
+  if (dropped != NULL) {
+    checkpoint->dropped += 1;
+  }
+  pthread_cond_signal(&checkpoint->wake);
+  pthread_mutex_unlock(&checkpoint->lock);
+
+  for (unsigned int i = 0; i < num_done; i++) {
+    free_state(done[i]);
+  }
+  if (dropped != NULL) {
+    free_state(dropped);
+  }
+}
+
+/*
+  Waits for the last queued snapshot to be written, then stops the writer. Returns 0, or the
+  errno of the first checkpoint that could not be written.
+*/
+int checkpoint_destroy(checkpoint_t* checkpoint) {
+  pthread_mutex_lock(&checkpoint->lock);
+  checkpoint->stopping = true;
+  pthread_cond_signal(&checkpoint->wake);
+  pthread_mutex_unlock(&checkpoint->lock);
+  pthread_join(checkpoint->thread, NULL);
+
+  for (unsigned int i = 0; i < checkpoint->num_done; i++) {
+    free_state(checkpoint->done[i]);
+  }
+  int error = checkpoint->error;
+  pthread_mutex_destroy(&checkpoint->lock);
+  pthread_cond_destroy(&checkpoint->wake);
+  free(checkpoint->filename);
+  free(checkpoint->tmp_filename);
+  free(checkpoint);
+  return error;
+}
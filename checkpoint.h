@@ -0,0 +1,46 @@
+#ifndef _SNK_CHECKPOINT_H
+#define _SNK_CHECKPOINT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "state.h"
+
+/*
+  Writes snapshots of a running game to disk on a background thread. checkpoint_save only takes a
+  copy-on-write clone of the state and hands it over, so the game keeps running while the file is
+  written. Each file is written under a temporary name, synced, and renamed over the previous
+  checkpoint, so the file on disk is always a complete board.
+
+  There are two snapshot slots: the one being written and the next one waiting. If a new snapshot
+  arrives while one is still waiting, the waiting one is dropped in favour of the newer board.
+*/
+typedef struct checkpoint_t {
+  char* filename;
+  char* tmp_filename;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+
+  // Waiting to be written, and being written
+  game_state_t* pending;
+  game_state_t* writing;
+  // Written but not yet freed. Snapshots share rows with the live state, so they are only freed on
+  // the game's thread. At most two can pile up between calls to checkpoint_save: the one that was
+  // being written when it was last called, and the one that was pending.
+  game_state_t* done[2];
+  unsigned int num_done;
+  bool stopping;
+
+  unsigned long saved;
+  unsigned long written;
+  unsigned long dropped;
+  // errno of the first failed write, or 0
+  int error;
+} checkpoint_t;
+
+checkpoint_t* checkpoint_create(const char* filename);
+void checkpoint_save(checkpoint_t* checkpoint, game_state_t* state);
+int checkpoint_destroy(checkpoint_t* checkpoint);
+
+#endif
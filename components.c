@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+#include "components.h"
+
+static const int dx[] = {0, -1, 0, 1};
+static const int dy[] = {-1, 0, 1, 0};
+
+// The eight cells around a cell, in order around the ring, starting above it
+static const int ring_dx[] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int ring_dy[] = {-1, -1, 0, 1, 1, 1, 0, -1};
+
+static bool is_free(char c) {
+  return c == ' ' || c == '*';
+}
+
+static bool free_at(components_t* components, int x, int y) {
+  if (x < 0 || y < 0 || x >= (int) components->x_size || y >= (int) components->y_size) {
+    return false;
+  }
+  return is_free(get_board_at(components->state, x, y));
+}
+
+static uint32_t find(components_t* components, uint32_t n) {
+  uint32_t* parent = components->parent;
+  while (parent[n] != n) {
+    parent[n] = parent[parent[n]];
+    n = parent[n];
+  }
+  return n;
+}
+
+static void join(components_t* components, uint32_t a, uint32_t b) {
+  a = find(components, a);
+  b = find(components, b);
+  if (a == b) {
+    return;
+  }
+  if (components->size[a] < components->size[b]) {
+    uint32_t t = a;
+    a = b;
+    b = t;
+  }
+  components->parent[b] = a;
+  components->size[a] += components->size[b];
+}
+
+static uint32_t new_node(components_t* components) {
+  uint32_t n = components->num_nodes;
+  components->num_nodes += 1;
+  components->parent[n] = n;
+  components->size[n] = 0;
+  return n;
+}
+
+/* Starts a new search. Each search owns four stamps, one per side. */
+static void next_stamp(components_t* components) {
+  if (components->stamp > UINT32_MAX - 8) {
+    memset(components->seen, 0, (size_t) components->x_size * components->y_size * sizeof(uint32_t));
+    components->stamp = 0;
+  }
+  components->stamp += 4;
+}
+
+/* Gives every free cell connected to (x, y) the new root node n, counting them into its size. */
+static void flood(components_t* components, unsigned int x, unsigned int y, uint32_t n) {
+  unsigned int x_size = components->x_size;
+  uint32_t* queue = components->queue;
+  size_t head = 0;
+  size_t tail = 0;
+  uint32_t start = y * x_size + x;
+  components->seen[start] = components->stamp;
+  queue[tail++] = start;
+  while (head < tail) {
+    uint32_t cell = queue[head++];
+    components->node[cell] = n;
+    components->size[n] += 1;
+    int cx = cell % x_size;
+    int cy = cell / x_size;
+    for (int dir = 0; dir < 4; dir++) {
+      int nx = cx + dx[dir];
+      int ny = cy + dy[dir];
+      uint32_t next = ny * x_size + nx;
+      if (free_at(components, nx, ny) && components->seen[next] != components->stamp) {
+        components->seen[next] = components->stamp;
+        queue[tail++] = next;
+      }
+    }
+  }
+}
+
+/* Recomputes every region from scratch, which also throws away every node no cell uses. */
+static void rebuild(components_t* components) {
+  size_t cells = (size_t) components->x_size * components->y_size;
+  components->num_nodes = 0;
+  for (size_t cell = 0; cell < cells; cell++) {
+    components->node[cell] = COMPONENTS_NONE;
+  }
+  next_stamp(components);
+  for (unsigned int y = 0; y < components->y_size; y++) {
+    for (unsigned int x = 0; x < components->x_size; x++) {
+      uint32_t cell = y * components->x_size + x;
+      if (components->seen[cell] != components->stamp && free_at(components, x, y)) {
+        flood(components, x, y, new_node(components));
+      }
+    }
+  }
+  components->rebuilds += 1;
+}
+
+/*
+  True if the free cells next to (x, y) are still connected to each other through the ring of
+  eight cells around it, in which case blocking (x, y) can't have split its region.
+*/
+static bool ring_connected(components_t* components, int x, int y) {
+  bool open[8];
+  for (int i = 0; i < 8; i++) {
+    open[i] = free_at(components, x + ring_dx[i], y + ring_dy[i]);
+  }
+  // Count the runs of free ring cells that hold at least one of the four direct neighbors
+  int runs = 0;
+  for (int i = 0; i < 8; i++) {
+    if (!open[i] || open[(i + 7) % 8]) {
+      continue;
+    }
+    bool direct = false;
+    for (int j = i; j < i + 8 && open[j % 8]; j++) {
+      direct = direct || j % 2 == 0;
+    }
+    runs += direct;
+  }
+  return runs <= 1;
+}
+
+static int find_group(int* group, int i) {
+  while (group[i] != i) {
+    i = group[i];
+  }
+  return i;
+}
+
+/*
+  Blocking (x, y) may have split region root. Searches outwards from each free neighbor in
+  lockstep, merging sides that meet, until at most one group of sides is still growing. Every
+  group that ran out of cells is a region of its own, so all of them but one move to new roots
+  (all of them, if a group is still growing), and the work done is about the size of the smaller
+  pieces rather than of the whole region.
+*/
+static void split(components_t* components, int x, int y, uint32_t root) {
+  unsigned int x_size = components->x_size;
+  uint32_t* queue = components->queue;
+  uint8_t* side = components->side;
+  size_t tail = 0;
+  size_t head[4];
+  bool done[4];
+  int group[4];
+  int num_sides = 0;
+
+  next_stamp(components);
+  uint32_t stamp = components->stamp;
+  for (int dir = 0; dir < 4; dir++) {
+    if (free_at(components, x + dx[dir], y + dy[dir])) {
+      uint32_t start = (y + dy[dir]) * x_size + x + dx[dir];
+      components->seen[start] = stamp + num_sides;
+      queue[tail] = start;
+      side[tail] = num_sides;
+      head[num_sides] = tail;
+      done[num_sides] = false;
+      group[num_sides] = num_sides;
+      tail += 1;
+      num_sides += 1;
+    }
+  }
+
+  for (;;) {
+    bool growing[4] = {false};
+    int num_growing = 0;
+    for (int i = 0; i < num_sides; i++) {
+      int g = find_group(group, i);
+      if (!done[i] && !growing[g]) {
+        growing[g] = true;
+        num_growing += 1;
+      }
+    }
+    if (num_growing <= 1) {
+      break;
+    }
+
+    for (int i = 0; i < num_sides; i++) {
+      if (done[i]) {
+        continue;
+      }
+      while (head[i] < tail && side[head[i]] != i) {
+        head[i] += 1;
+      }
+      if (head[i] == tail) {
+        done[i] = true;
+        continue;
+      }
+      uint32_t cell = queue[head[i]];
+      head[i] += 1;
+      int cx = cell % x_size;
+      int cy = cell / x_size;
+      for (int dir = 0; dir < 4; dir++) {
+        int nx = cx + dx[dir];
+        int ny = cy + dy[dir];
+        if (!free_at(components, nx, ny)) {
+          continue;
+        }
+        uint32_t next = ny * x_size + nx;
+        uint32_t seen = components->seen[next];
+        if (seen >= stamp && seen < stamp + 4) {
+          // Reached a cell of another side, so both are the same piece
+          group[find_group(group, i)] = find_group(group, seen - stamp);
+        } else {
+          components->seen[next] = stamp + i;
+          queue[tail] = next;
+          side[tail] = i;
+          tail += 1;
+        }
+      }
+    }
+  }
+
+  // The piece that is still growing keeps the old root; if none is, the largest one does
+  bool finished[4];
+  uint32_t cells[4] = {0};
+  for (int i = 0; i < num_sides; i++) {
+    finished[i] = true;
+  }
+  for (int i = 0; i < num_sides; i++) {
+    finished[find_group(group, i)] = finished[find_group(group, i)] && done[i];
+  }
+  for (size_t i = 0; i < tail; i++) {
+    cells[find_group(group, side[i])] += 1;
+  }
+  int keep = -1;
+  for (int i = 0; i < num_sides; i++) {
+    if (find_group(group, i) != i) {
+      continue;
+    }
+    if (!finished[i]) {
+      keep = i;
+      break;
+    }
+    if (keep < 0 || cells[i] > cells[keep]) {
+      keep = i;
+    }
+  }
+
+  uint32_t nodes[4];
+  for (int i = 0; i < num_sides; i++) {
+    if (find_group(group, i) == i && i != keep) {
+      nodes[i] = new_node(components);
+      components->size[nodes[i]] = cells[i];
+      components->size[root] -= cells[i];
+    }
+  }
+  for (size_t i = 0; i < tail; i++) {
+    int g = find_group(group, side[i]);
+    if (g != keep) {
+      components->node[queue[i]] = nodes[g];
+    }
+  }
+  components->splits += 1;
+}
+
+static void watch_cell(game_state_t* state, int x, int y, char old_ch, char new_ch, void* ctx) {
+  if (is_free(old_ch) == is_free(new_ch)) {
+    return;
+  }
+  components_t* components = ctx;
+  uint32_t cell = y * components->x_size + x;
+
+  // No change needs more than four new nodes
+  if (components->num_nodes > components->max_nodes - 4) {
+    rebuild(components);
+    return;
+  }
+
+  if (is_free(new_ch)) {
+    // Nodes of closed cells may still be shared, so an opened cell always starts a new one
+    uint32_t n = new_node(components);
+    components->size[n] = 1;
+    components->node[cell] = n;
+    for (int dir = 0; dir < 4; dir++) {
+      if (free_at(components, x + dx[dir], y + dy[dir])) {
+        join(components, n, components->node[(y + dy[dir]) * components->x_size + x + dx[dir]]);
+      }
+    }
+    return;
+  }
+
+  uint32_t root = find(components, components->node[cell]);
+  components->node[cell] = COMPONENTS_NONE;
+  components->size[root] -= 1;
+  if (!ring_connected(components, x, y)) {
+    split(components, x, y, root);
+  }
+}
+
+/* Attaches a region tracker to state. Returns NULL if state has no free watcher slot. */
+components_t* components_create(game_state_t* state) {
+  components_t* components = calloc(1, sizeof(components_t));
+  size_t cells = (size_t) state->x_size * state->y_size;
+  components->state = state;
+  components->x_size = state->x_size;
+  components->y_size = state->y_size;
+  // Room for every cell to get a node of its own once more before the forest is rebuilt
+  components->max_nodes = cells > UINT32_MAX / 2 - 4 ? UINT32_MAX : 2 * cells + 4;
+  components->node = malloc(cells * sizeof(uint32_t));
+  components->parent = malloc((size_t) components->max_nodes * sizeof(uint32_t));
+  components->size = malloc((size_t) components->max_nodes * sizeof(uint32_t));
+  components->seen = calloc(cells, sizeof(uint32_t));
+  components->queue = malloc(cells * sizeof(uint32_t));
+  components->side = malloc(cells);
+  if (!watch_board(state, watch_cell, components)) {
+    components->state = NULL;
+    components_destroy(components);
+    return NULL;
+  }
+  rebuild(components);
+  return components;
+}
+
+void components_destroy(components_t* components) {
+  if (components->state != NULL) {
+    unwatch_board(components->state, watch_cell, components);
+  }
+  free(components->node);
+  free(components->parent);
+  free(components->size);
+  free(components->seen);
+  free(components->queue);
+  free(components->side);
+  free(components);
+}
+
+/*
+  Returns an identifier for the region holding (x, y), shared by every cell of that region until
+  the board changes, or COMPONENTS_NONE if the cell isn't free.
+*/
+uint32_t components_region(components_t* components, unsigned int x, unsigned int y) {
+  uint32_t n = components->node[y * components->x_size + x];
+  return n == COMPONENTS_NONE ? COMPONENTS_NONE : find(components, n);
+}
+
+/* Returns the number of free cells in the region holding (x, y), or 0 if the cell isn't free. */
+uint32_t components_region_size(components_t* components, unsigned int x, unsigned int y) {
+  uint32_t region = components_region(components, x, y);
+  return region == COMPONENTS_NONE ? 0 : components->size[region];
+}
@@ -0,0 +1,51 @@
+#ifndef _SNK_COMPONENTS_H
+#define _SNK_COMPONENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "state.h"
+
+#define COMPONENTS_NONE UINT32_MAX
+
+/*
+  Connected regions of free cells (empty or food), kept up to date as the game runs so that "how
+  much room is there around this cell" doesn't need a flood fill per question.
+
+  Regions live in a union-find forest. Cells that open up are joined to their free neighbors right
+  away. Cells that close can split a region, which a union-find can't undo: if the free neighbors
+  of a closed cell aren't obviously still connected, a search runs outwards from all of them in
+  lockstep until every side but one has been explored completely, and only those smaller sides get
+  new regions. Cells get a fresh node whenever they open or move to a new region, so old nodes can
+  stay in the forest until it fills up and is rebuilt from the board.
+*/
+typedef struct components_t {
+  game_state_t* state;
+  unsigned int x_size;
+  unsigned int y_size;
+
+  // Node of each free cell, or COMPONENTS_NONE for blocked cells
+  uint32_t* node;
+
+  // Union-find forest over nodes; size only means something at roots
+  uint32_t* parent;
+  uint32_t* size;
+  uint32_t num_nodes;
+  uint32_t max_nodes;
+
+  // Scratch space for searches: which search (and side) last reached each cell, the cells reached
+  // in order, and the side that reached each of them
+  uint32_t* seen;
+  uint32_t stamp;
+  uint32_t* queue;
+  uint8_t* side;
+
+  unsigned long splits;
+  unsigned long rebuilds;
+} components_t;
+
+components_t* components_create(game_state_t* state);
+void components_destroy(components_t* components);
+uint32_t components_region(components_t* components, unsigned int x, unsigned int y);
+uint32_t components_region_size(components_t* components, unsigned int x, unsigned int y);
+
+#endif
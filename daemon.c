@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "daemon.h"
+#include "sim.h"
+#include "snake_utils.h"
+
+// Longest text request header that is accepted, newline included
+#define TEXT_HEADER_MAX 64
+#define READ_SIZE 65536
+
+static void put_u32(uint8_t* buf, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    buf[i] = value >> (8 * i);
+  }
+}
+
+static uint32_t get_u32(const uint8_t* buf) {
+  return (uint32_t) buf[0] | (uint32_t) buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static void put_u64(uint8_t* buf, uint64_t value) {
+  put_u32(buf, (uint32_t) value);
+  put_u32(buf + 4, (uint32_t) (value >> 32));
+}
+
+static uint64_t get_u64(const uint8_t* buf) {
+  return (uint64_t) get_u32(buf) | (uint64_t) get_u32(buf + 4) << 32;
+}
+
+/* Fills in the header of a binary request. */
+void daemon_put_request(uint8_t* header, uint64_t ticks, uint32_t length) {
+  memcpy(header, DAEMON_MAGIC, 4);
+  put_u32(header + 4, length);
+  put_u64(header + 8, ticks);
+}
+
+/* Decodes the header of a binary response. Returns false if it doesn't start with the magic. */
+bool daemon_get_response(const uint8_t* header, uint32_t* status, uint64_t* hash, uint32_t* length) {
+  if (memcmp(header, DAEMON_MAGIC, 4) != 0) {
+    return false;
+  }
+  *status = get_u32(header + 4);
+  *hash = get_u64(header + 8);
+  *length = get_u32(header + 16);
+  return true;
+}
+
+/*
+  A worker serves one connection at a time. Its arena is sized for boards of the given shape and
+  touched once up front, so requests up to that size never reach malloc; bigger boards still work,
+  with the arena growing for the length of the request.
+*/
+daemon_worker_t* daemon_worker_create(unsigned int x_size, unsigned int y_size, unsigned int max_snakes,
+                                      size_t max_board, uint64_t max_ticks) {
+  daemon_worker_t* worker = calloc(1, sizeof(daemon_worker_t));
+  worker->pool = state_pool_create(1, x_size, y_size, max_snakes);
+  worker->max_board = max_board;
+  worker->max_ticks = max_ticks;
+  size_t arena_size = state_arena_size(x_size, y_size, max_snakes);
+  arena_t* arena = state_pool_acquire(worker->pool);
+  memset(arena_alloc(arena, arena_size), 0, arena_size);
+  state_pool_release(worker->pool, arena);
+
+  worker->input_capacity = READ_SIZE;
+  worker->input = malloc(worker->input_capacity);
+  worker->output_capacity = READ_SIZE;
+  worker->output = malloc(worker->output_capacity);
+  worker->errors = fmemopen(worker->error_text, sizeof(worker->error_text), "w");
+  return worker;
+}
+
+void daemon_worker_destroy(daemon_worker_t* worker) {
+  state_pool_destroy(worker->pool);
+  fclose(worker->errors);
+  free(worker->input);
+  free(worker->output);
+  free(worker);
+}
+
+static void reserve_output(daemon_worker_t* worker, size_t size) {
+  if (worker->output_len + size > worker->output_capacity) {
+    worker->output_capacity = (worker->output_len + size) * 2;
+    worker->output = realloc(worker->output, worker->output_capacity);
+  }
+}
+
+static void append_output(daemon_worker_t* worker, const void* data, size_t size) {
+  reserve_output(worker, size);
+  memcpy(worker->output + worker->output_len, data, size);
+  worker->output_len += size;
+}
+
+static void respond_error(daemon_worker_t* worker, bool binary, const char* message) {
+  size_t length = strlen(message);
+  if (binary) {
+    uint8_t header[DAEMON_RESPONSE_HEADER_SIZE];
+    memcpy(header, DAEMON_MAGIC, 4);
+    put_u32(header + 4, 1);
+    put_u64(header + 8, 0);
+    put_u32(header + 16, length);
+    append_output(worker, header, sizeof(header));
+    append_output(worker, message, length);
+  } else {
+    append_output(worker, "error ", 6);
+    append_output(worker, message, length);
+    append_output(worker, "\n", 1);
+  }
+}
+
+static void respond_board(daemon_worker_t* worker, bool binary, game_state_t* state) {
+  size_t row_size = state->x_size + 1;
+  size_t length = row_size * state->y_size;
+  if (binary) {
+    uint8_t header[DAEMON_RESPONSE_HEADER_SIZE];
+    memcpy(header, DAEMON_MAGIC, 4);
+    put_u32(header + 4, 0);
+    put_u64(header + 8, state->hash);
+    put_u32(header + 16, length);
+    append_output(worker, header, sizeof(header));
+  } else {
+    char header[TEXT_HEADER_MAX];
+    int size = snprintf(header, sizeof(header), "ok %016" PRIx64 " %zu\n", state->hash, length);
+    append_output(worker, header, size);
+  }
+  // Rows already end in a newline, so the board goes out as print_board would write it
+  reserve_output(worker, length);
+  for (unsigned int y = 0; y < state->y_size; y++) {
+    memcpy(worker->output + worker->output_len, state->board[y], row_size);
+    worker->output_len += row_size;
+  }
+}
+
+/* Loads the board, runs it for ticks and appends the response. */
+static void run_request(daemon_worker_t* worker, bool binary, char* board, size_t length, uint64_t ticks) {
+  arena_t* arena = state_pool_acquire(worker->pool);
+  rewind(worker->errors);
+  game_state_t* state = load_board_from_memory_in(arena, "board", board, length, worker->errors);
+  if (state == NULL) {
+    fflush(worker->errors);
+    size_t size = ftell(worker->errors);
+    // Drop the newline that ends the message
+    worker->error_text[size > 0 ? size - 1 : 0] = '\0';
+    respond_error(worker, binary, worker->error_text);
+  } else {
+    initialize_snakes(state);
+    seed = 1;
+    snake_seed = 1;
+    sim_result_t result;
+    simulate(state, deterministic_food, NULL, NULL, ticks, true, &result);
+    respond_board(worker, binary, state);
+  }
+  state_pool_release(worker->pool, arena);
+  worker->requests += 1;
+}
+
+/* Parses "<ticks> <length>\n". */
+static bool parse_text_header(const char* line, uint64_t* ticks, size_t* length) {
+  char* end;
+  if (*line < '0' || *line > '9') {
+    return false;
+  }
+  *ticks = strtoull(line, &end, 10);
+  if (*end != ' ' || end[1] < '0' || end[1] > '9') {
+    return false;
+  }
+  *length = strtoull(end + 1, &end, 10);
+  return *end == '\n' || (*end == '\r' && end[1] == '\n');
+}
+
+/*
+  Serves the request at the front of the input if all of it has arrived. Returns 1 if it did, 0
+  if more input is needed (and sets needed to how much), or -1 if the connection has to close.
+*/
+static int serve_next(daemon_worker_t* worker, size_t* needed) {
+  char* start = worker->input + worker->input_pos;
+  size_t avail = worker->input_len - worker->input_pos;
+  size_t magic_len = avail < 4 ? avail : 4;
+  bool binary = memcmp(start, DAEMON_MAGIC, magic_len) == 0;
+  uint64_t ticks;
+  size_t length;
+  size_t header_size;
+  if (binary) {
+    *needed = DAEMON_REQUEST_HEADER_SIZE;
+    if (avail < DAEMON_REQUEST_HEADER_SIZE) {
+      return 0;
+    }
+    length = get_u32((uint8_t*) start + 4);
+    ticks = get_u64((uint8_t*) start + 8);
+    header_size = DAEMON_REQUEST_HEADER_SIZE;
+  } else {
+    char* newline = memchr(start, '\n', avail < TEXT_HEADER_MAX ? avail : TEXT_HEADER_MAX);
+    if (newline == NULL) {
+      *needed = avail + 1;
+      if (avail < TEXT_HEADER_MAX) {
+        return 0;
+      }
+      respond_error(worker, false, "malformed request");
+      return -1;
+    }
+    char line[TEXT_HEADER_MAX + 1];
+    header_size = newline - start + 1;
+    memcpy(line, start, header_size);
+    line[header_size] = '\0';
+    if (!parse_text_header(line, &ticks, &length)) {
+      respond_error(worker, false, "malformed request");
+      return -1;
+    }
+  }
+  if (length > worker->max_board) {
+    respond_error(worker, binary, "board is too large");
+    return -1;
+  }
+  *needed = header_size + length;
+  if (avail < *needed) {
+    return 0;
+  }
+  if (ticks > worker->max_ticks) {
+    respond_error(worker, binary, "too many ticks");
+  } else {
+    run_request(worker, binary, start + header_size, length, ticks);
+  }
+  worker->input_pos += *needed;
+  return 1;
+}
+
+/* Sends every response built so far. */
+static bool flush_output(daemon_worker_t* worker, int fd) {
+  size_t sent = 0;
+  while (sent < worker->output_len) {
+    ssize_t n = send(fd, worker->output + sent, worker->output_len - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  worker->output_len = 0;
+  return true;
+}
+
+/*
+  Serves requests from fd until the other end closes it. Returns false if the connection ended in
+  the middle of a request or on an error.
+*/
+bool daemon_serve(daemon_worker_t* worker, int fd) {
+  worker->input_pos = 0;
+  worker->input_len = 0;
+  worker->output_len = 0;
+  while (true) {
+    int status;
+    size_t needed = 0;
+    while ((status = serve_next(worker, &needed)) > 0) {
+    }
+    // Responses only go out once every request that has arrived is answered
+    if (!flush_output(worker, fd) || status < 0) {
+      return false;
+    }
+
+    // Move the partial request to the front and make room for the rest of it
+    size_t pending = worker->input_len - worker->input_pos;
+    memmove(worker->input, worker->input + worker->input_pos, pending);
+    worker->input_pos = 0;
+    worker->input_len = pending;
+    if (needed + READ_SIZE > worker->input_capacity) {
+      worker->input_capacity = needed + READ_SIZE;
+      worker->input = realloc(worker->input, worker->input_capacity);
+    }
+
+    ssize_t n = read(fd, worker->input + worker->input_len, worker->input_capacity - worker->input_len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return n == 0 && pending == 0;
+    }
+    worker->input_len += n;
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef _SNK_DAEMON_H
+#define _SNK_DAEMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "state.h"
+
+#define DAEMON_MAGIC "SNKD"
+#define DAEMON_REQUEST_HEADER_SIZE 16
+#define DAEMON_RESPONSE_HEADER_SIZE 20
+#define DAEMON_MAX_BOARD (16 << 20)
+#define DAEMON_MAX_TICKS 10000000
+#define DAEMON_SOCKET "snaked.sock"
+
+/*
+  The simulation service behind snaked. A connection carries any number of requests, each a board
+  and a tick count, and gets one response per request, in order. Every request starts from the
+  seeds a fresh ./snake starts with, so its result is exactly what ./snake -n ticks prints for
+  the same board.
+
+  Requests are either text or binary, and the two can be mixed on one connection:
+
+    text request:     "<ticks> <length>\n", then length bytes of board
+    text response:    "ok <hash> <length>\n", then the board after ticks, or "error <message>\n"
+    binary request:   magic "SNKD", length (u32), ticks (u64), then length bytes of board
+    binary response:  magic "SNKD", status (u32, 0 when ok), hash (u64), length (u32), then either
+                      the board after ticks or the error message
+
+  The hash is the board hash that ./snake --hash prints, in hex for text responses. All integers
+  are little-endian. A board that can't be loaded or asks for more than max_ticks ticks only fails
+  its own request, but a malformed header or a board longer than max_board closes the connection
+  after the error.
+*/
+typedef struct daemon_worker_t {
+  // Pre-warmed arenas that requests load their board into
+  state_pool_t* pool;
+  size_t max_board;
+  uint64_t max_ticks;
+  unsigned long requests;
+
+  // Bytes read from the connection; the next request starts at input_pos
+  char* input;
+  size_t input_pos;
+  size_t input_len;
+  size_t input_capacity;
+
+  // Responses waiting to be sent, so pipelined requests go back in as few writes as possible
+  char* output;
+  size_t output_len;
+  size_t output_capacity;
+
+  // Board errors are written through errors into error_text
+  FILE* errors;
+  char error_text[256];
+} daemon_worker_t;
+
+daemon_worker_t* daemon_worker_create(unsigned int x_size, unsigned int y_size, unsigned int max_snakes,
+                                      size_t max_board, uint64_t max_ticks);
+void daemon_worker_destroy(daemon_worker_t* worker);
+bool daemon_serve(daemon_worker_t* worker, int fd);
+
+void daemon_put_request(uint8_t* header, uint64_t ticks, uint32_t length);
+bool daemon_get_response(const uint8_t* header, uint32_t* status, uint64_t* hash, uint32_t* length);
+
+#endif
@@ -0,0 +1,111 @@
+#include "fixed_engine.h"
+#include "stats.h"
+
+/*
+  update_state, stamped out once per board shape that is common enough to deserve its own copy.
+  With the snake count a compile-time bound the loop over live snakes is unrolled, and each snake
+  decodes its head and tail through lookup tables and reads every cell once, where the generic
+  engine goes through next_square, update_head and update_tail. Writes still go through
+  set_board_at, so the hash, copy-on-write rows and board watchers behave exactly as with
+  update_state, and the steps are counted under the same stats phases.
+
+  The shapes are an X-macro of X(width, height, snakes); build with
+  make FIXED_SIZES='X(20, 20, 2) X(40, 30, 8)' to specialize for others.
+*/
+#ifndef SNK_FIXED_SIZES
+#define SNK_FIXED_SIZES(X) X(14, 10, 1) X(14, 10, 2) X(28, 31, 4)
+#endif
+
+// Step taken by a head or tail character, and what a snake running into a cell does
+static const signed char step_x[256] = {['>'] = 1, ['d'] = 1, ['<'] = -1, ['a'] = -1};
+static const signed char step_y[256] = {['v'] = 1, ['s'] = 1, ['^'] = -1, ['w'] = -1};
+static const bool deadly[256] = {
+  ['#'] = true, ['^'] = true, ['<'] = true, ['>'] = true, ['v'] = true, ['x'] = true,
+  ['w'] = true, ['a'] = true, ['s'] = true, ['d'] = true,
+};
+static const char body_to_tail[256] = {['^'] = 'w', ['<'] = 'a', ['v'] = 's', ['>'] = 'd'};
+
+/* Moves one live snake. Returns false if it died instead. */
+static inline bool step_snake(game_state_t* state, snake_t* snake,
+                              int (*add_food)(game_state_t* state)) {
+  STATS_START(STATS_NEXT_SQUARE);
+  char head = state->board[snake->head_y][snake->head_x];
+  unsigned int x = snake->head_x + step_x[(unsigned char) head];
+  unsigned int y = snake->head_y + step_y[(unsigned char) head];
+  char next = state->board[y][x];
+  STATS_STOP(STATS_NEXT_SQUARE);
+  if (deadly[(unsigned char) next]) {
+    snake->live = false;
+    set_board_at(state, snake->head_x, snake->head_y, 'x');
+    return false;
+  }
+  STATS_START(STATS_UPDATE_HEAD);
+  set_board_at(state, x, y, head);
+  snake->head_x = x;
+  snake->head_y = y;
+  STATS_STOP(STATS_UPDATE_HEAD);
+  if (next == '*') {
+    STATS_START(STATS_ADD_FOOD);
+    add_food(state);
+    STATS_STOP(STATS_ADD_FOOD);
+    return true;
+  }
+
+  STATS_START(STATS_UPDATE_TAIL);
+  char tail = state->board[snake->tail_y][snake->tail_x];
+  x = snake->tail_x + step_x[(unsigned char) tail];
+  y = snake->tail_y + step_y[(unsigned char) tail];
+  char after = body_to_tail[(unsigned char) state->board[y][x]];
+  set_board_at(state, snake->tail_x, snake->tail_y, ' ');
+  set_board_at(state, x, y, after != '\0' ? after : '?');
+  snake->tail_x = x;
+  snake->tail_y = y;
+  STATS_STOP(STATS_UPDATE_TAIL);
+  return true;
+}
+
+#define FIXED_ENGINE(W, H, N)                                                                  \
+  static void update_##W##x##H##_##N(game_state_t* state, int (*add_food)(game_state_t* state)) { \
+    if (state->live_snakes == NULL) {                                                          \
+      refresh_live_snakes(state);                                                              \
+    }                                                                                          \
+    snake_t* snakes = state->snakes;                                                           \
+    unsigned int* live = state->live_snakes;                                                   \
+    unsigned int num_live = state->num_live;                                                   \
+    unsigned int kept = 0;                                                                     \
+    for (unsigned int j = 0; j < (N) && j < num_live; j++) {                                   \
+      unsigned int i = live[j];                                                                \
+      live[kept] = i;                                                                          \
+      kept += step_snake(state, &snakes[i], add_food);                                         \
+    }                                                                                          \
+    state->num_live = kept;                                                                    \
+  }
+SNK_FIXED_SIZES(FIXED_ENGINE)
+
+#define FIXED_SIZE(W, H, N) {(W), (H), (N), update_##W##x##H##_##N},
+const fixed_size_t fixed_sizes[] = {SNK_FIXED_SIZES(FIXED_SIZE)};
+const unsigned int num_fixed_sizes = sizeof(fixed_sizes) / sizeof(fixed_sizes[0]);
+
+/*
+  Returns the update_state specialized for the shape of state, or update_state itself if there is
+  none.
+*/
+update_fn_t fixed_engine_for(game_state_t* state) {
+  // The variants read rows directly, which sparse boards don't have
+  if (state->sparse != NULL) {
+    return update_state;
+  }
+  for (unsigned int i = 0; i < num_fixed_sizes; i++) {
+    const fixed_size_t* size = &fixed_sizes[i];
+    if (size->x_size == state->x_size && size->y_size == state->y_size
+        && size->num_snakes == state->num_snakes) {
+      return size->update;
+    }
+  }
+  return update_state;
+}
+
+/* Same as update_state, through the specialized engine when state has one of the fixed shapes. */
+void fixed_update_state(game_state_t* state, int (*add_food)(game_state_t* state)) {
+  fixed_engine_for(state)(state, add_food);
+}
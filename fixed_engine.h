@@ -0,0 +1,22 @@
+#ifndef _SNK_FIXED_ENGINE_H
+#define _SNK_FIXED_ENGINE_H
+
+#include "state.h"
+
+typedef void (*update_fn_t)(game_state_t* state, int (*add_food)(game_state_t* state));
+
+/* A board shape with an update_state of its own. */
+typedef struct fixed_size_t {
+  unsigned int x_size;
+  unsigned int y_size;
+  unsigned int num_snakes;
+  update_fn_t update;
+} fixed_size_t;
+
+extern const fixed_size_t fixed_sizes[];
+extern const unsigned int num_fixed_sizes;
+
+update_fn_t fixed_engine_for(game_state_t* state);
+void fixed_update_state(game_state_t* state, int (*add_food)(game_state_t* state));
+
+#endif
@@ -0,0 +1,169 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "frame_ring.h"
+
+// Give up on a slot after this many torn reads and move on to whatever is newest by then
+#define READ_ATTEMPTS 16
+
+static size_t slot_size(unsigned int x_size, unsigned int y_size) {
+  size_t size = sizeof(frame_slot_t) + (size_t) (x_size + 1) * y_size;
+  // Keep every slot on its own cache lines
+  return (size + 63) / 64 * 64;
+}
+
+static frame_slot_t* get_slot(frame_ring_t* ring, uint64_t frame) {
+  char* slots = (char*) ring->header + (sizeof(frame_ring_header_t) + 63) / 64 * 64;
+  return (frame_slot_t*) (slots + (frame % ring->header->num_slots) * ring->header->slot_size);
+}
+
+/* Creates (or replaces) the shared-memory ring called name. Returns NULL if it can't be created. */
+frame_ring_t* frame_ring_create(const char* name, unsigned int x_size, unsigned int y_size, unsigned int num_slots) {
+  size_t size = (sizeof(frame_ring_header_t) + 63) / 64 * 64 + num_slots * slot_size(x_size, y_size);
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+  void* base = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) {
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "%s: %s\n", name, strerror(errno));
+    shm_unlink(name);
+    return NULL;
+  }
+
+  frame_ring_t* ring = malloc(sizeof(frame_ring_t));
+  ring->name = strdup(name);
+  ring->writer = true;
+  ring->size = size;
+  ring->header = base;
+  ring->header->num_slots = num_slots;
+  ring->header->x_size = x_size;
+  ring->header->y_size = y_size;
+  ring->header->slot_size = slot_size(x_size, y_size);
+  ring->header->published = 0;
+  ring->header->closed = 0;
+  // Readers check the magic number last, once the rest of the header is filled in
+  __atomic_store_n(&ring->header->magic, FRAME_RING_MAGIC, __ATOMIC_RELEASE);
+  return ring;
+}
+
+/* Copies the board into the next slot. Never waits, whatever the readers are doing. */
+void frame_ring_publish(frame_ring_t* ring, game_state_t* state, uint64_t timestep) {
+  frame_ring_header_t* header = ring->header;
+  uint64_t frame = header->published;
+  frame_slot_t* slot = get_slot(ring, frame);
+
+  uint64_t seq = slot->seq;
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->frame = frame;
+  slot->timestep = timestep;
+  size_t row_size = header->x_size + 1;
+  for (unsigned int y = 0; y < header->y_size; y++) {
+    char* row = slot->cells + y * row_size;
+    if (state->sparse == NULL) {
+      memcpy(row, state->board[y], row_size);
+      continue;
+    }
+    // Sparse boards have no rows to copy
+    for (unsigned int x = 0; x < header->x_size; x++) {
+      row[x] = sparse_board_get(state->sparse, x, y);
+    }
+    row[header->x_size] = '\n';
+  }
+  __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&header->published, frame + 1, __ATOMIC_RELEASE);
+}
+
+/* Attaches read-only to an existing ring. Returns NULL if there is no such ring. */
+frame_ring_t* frame_ring_attach(const char* name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(frame_ring_header_t)) {
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "%s: not a frame ring\n", name);
+    return NULL;
+  }
+  frame_ring_header_t* header = base;
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != FRAME_RING_MAGIC
+      || (size_t) st.st_size < (sizeof(frame_ring_header_t) + 63) / 64 * 64 + header->num_slots * header->slot_size) {
+    fprintf(stderr, "%s: not a frame ring\n", name);
+    munmap(base, st.st_size);
+    return NULL;
+  }
+
+  frame_ring_t* ring = malloc(sizeof(frame_ring_t));
+  ring->name = strdup(name);
+  ring->writer = false;
+  ring->size = st.st_size;
+  ring->header = header;
+  return ring;
+}
+
+/*
+  Copies the newest frame into frame, allocating frame->cells if it is NULL (free it when done).
+  Returns false if nothing has been published yet, or if the writer kept overwriting the slot.
+*/
+bool frame_ring_read(frame_ring_t* ring, frame_t* frame) {
+  frame_ring_header_t* header = ring->header;
+  size_t cells_size = (size_t) (header->x_size + 1) * header->y_size;
+  if (frame->cells == NULL) {
+    frame->cells = malloc(cells_size);
+  }
+  for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+    uint64_t published = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+    if (published == 0) {
+      return false;
+    }
+    frame_slot_t* slot = get_slot(ring, published - 1);
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq % 2 == 1) {
+      continue;
+    }
+    frame->frame = slot->frame;
+    frame->timestep = slot->timestep;
+    memcpy(frame->cells, slot->cells, cells_size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+      frame->x_size = header->x_size;
+      frame->y_size = header->y_size;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool frame_ring_closed(frame_ring_t* ring) {
+  return __atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+/* Detaches from the ring. The writer also marks it closed and removes its name. */
+void frame_ring_destroy(frame_ring_t* ring) {
+  if (ring->writer) {
+    __atomic_store_n(&ring->header->closed, 1, __ATOMIC_RELEASE);
+    shm_unlink(ring->name);
+  }
+  munmap(ring->header, ring->size);
+  free(ring->name);
+  free(ring);
+}
@@ -0,0 +1,61 @@
+#ifndef _SNK_FRAME_RING_H
+#define _SNK_FRAME_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "state.h"
+
+/*
+  A ring of board frames in POSIX shared memory, written by one running game and read by any number
+  of spectator processes. Each slot is guarded by a sequence counter that is odd while the slot is
+  being written, so readers copy a slot and then check that the counter didn't move. The writer
+  never waits for readers; a reader that falls behind just skips to the newest frame.
+*/
+#define FRAME_RING_MAGIC 0x534e4b46u
+#define FRAME_RING_SLOTS 8
+
+typedef struct frame_ring_header_t {
+  uint32_t magic;
+  uint32_t num_slots;
+  uint32_t x_size;
+  uint32_t y_size;
+  uint64_t slot_size;
+  // Number of frames published so far; the newest one is in slot (published - 1) % num_slots
+  uint64_t published;
+  // Set once the writer has gone away
+  uint32_t closed;
+} frame_ring_header_t;
+
+typedef struct frame_slot_t {
+  uint64_t seq;
+  uint64_t frame;
+  uint64_t timestep;
+  // y_size rows of x_size cells, each followed by a newline
+  char cells[];
+} frame_slot_t;
+
+typedef struct frame_ring_t {
+  char* name;
+  bool writer;
+  size_t size;
+  frame_ring_header_t* header;
+} frame_ring_t;
+
+/* A copy of one frame, filled in by frame_ring_read. */
+typedef struct frame_t {
+  uint64_t frame;
+  uint64_t timestep;
+  unsigned int x_size;
+  unsigned int y_size;
+  char* cells;
+} frame_t;
+
+frame_ring_t* frame_ring_create(const char* name, unsigned int x_size, unsigned int y_size, unsigned int num_slots);
+void frame_ring_publish(frame_ring_t* ring, game_state_t* state, uint64_t timestep);
+frame_ring_t* frame_ring_attach(const char* name);
+bool frame_ring_read(frame_ring_t* ring, frame_t* frame);
+bool frame_ring_closed(frame_ring_t* ring);
+void frame_ring_destroy(frame_ring_t* ring);
+
+#endif
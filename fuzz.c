@@ -0,0 +1,476 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fixed_engine.h"
+#include "snake_utils.h"
+#include "state.h"
+
+/*
+  Differential fuzzer. Generates random valid boards, runs the reference update_state on one copy
+  and a candidate engine on another, and compares the boards, snake tables and food seeds after
+  every tick. A board that makes the engines disagree is shrunk to a minimal repro and saved.
+*/
+
+typedef struct engine_t {
+  const char* name;
+  const char* description;
+  // Prepares the candidate's copy of a freshly loaded board
+  game_state_t* (*start)(game_state_t* loaded);
+  // Advances the candidate by one tick, possibly replacing the state
+  game_state_t* (*step)(game_state_t* state, int (*add_food)(game_state_t* state));
+  // Whether half of the boards should have the shapes of the fixed-size engine
+  bool fixed_shapes;
+} engine_t;
+
+/* Board text, one row per line, as it would appear in a .snk file. */
+typedef struct board_t {
+  unsigned int width;
+  unsigned int height;
+  char* cells;
+} board_t;
+
+typedef struct fuzz_t {
+  const engine_t* engine;
+  unsigned long max_ticks;
+  char scratch_filename[64];
+
+  double reference_ns;
+  double candidate_ns;
+  unsigned long ticks;
+  unsigned long boards;
+} fuzz_t;
+
+uint32_t fuzz_seed = 1;
+
+// Set by a candidate step that caught itself misbehaving; run_board treats it as a divergence
+const char* step_failure = NULL;
+
+/* Candidate: update_state on copy-on-write clones, checking that the parent of every clone stays untouched. */
+game_state_t* cow_start(game_state_t* loaded) {
+  return clone_state(loaded);
+}
+
+game_state_t* cow_step(game_state_t* state, int (*add_food)(game_state_t* state)) {
+  game_state_t* child = clone_state(state);
+  uint64_t parent_hash = state->hash;
+  update_state(child, add_food);
+  if (state->hash != parent_hash || board_hash(state) != parent_hash) {
+    step_failure = "writes to a clone leaked into its parent";
+  }
+  free_state(state);
+  return child;
+}
+
+/* Candidate: the fixed-size engine, which only differs from update_state on the shapes it was built for. */
+game_state_t* fixed_start(game_state_t* loaded) {
+  return loaded;
+}
+
+game_state_t* fixed_step(game_state_t* state, int (*add_food)(game_state_t* state)) {
+  fixed_update_state(state, add_food);
+  return state;
+}
+
+const engine_t engines[] = {
+  {"cow", "update_state on copy-on-write clones", cow_start, cow_step, false},
+  {"fixed", "fixed_update_state, specialized for a few board shapes", fixed_start, fixed_step, true},
+};
+
+#define NUM_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+/* deterministic_food, except that it gives up instead of looping forever on a full board. */
+int fuzz_food(game_state_t* state) {
+  for (unsigned int y = 0; y < state->y_size; y++) {
+    if (memchr(state->board[y], ' ', state->x_size) != NULL) {
+      return deterministic_food(state);
+    }
+  }
+  return 0;
+}
+
+double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+unsigned int rand_below(unsigned int n) {
+  return det_rand(&fuzz_seed) % n;
+}
+
+char* cell(board_t* board, int x, int y) {
+  return &board->cells[y * (board->width + 1) + x];
+}
+
+bool is_free(board_t* board, int x, int y) {
+  return x > 0 && y > 0 && x < board->width - 1 && y < board->height - 1 && *cell(board, x, y) == ' ';
+}
+
+bool is_snake_char(char c) {
+  return c != ' ' && c != '#' && c != '*' && c != '\n';
+}
+
+/* Lays down one snake as a random self-avoiding walk from its tail. Returns false if there was no room. */
+bool add_random_snake(board_t* board, unsigned int max_length) {
+  static const int dx[] = {0, -1, 0, 1};
+  static const int dy[] = {-1, 0, 1, 0};
+  static const char* tails = "wasd";
+  static const char* bodies = "^<v>";
+
+  int x = 1 + rand_below(board->width - 2);
+  int y = 1 + rand_below(board->height - 2);
+  if (!is_free(board, x, y)) {
+    return false;
+  }
+  unsigned int length = 2 + rand_below(max_length - 1);
+  int path_x[length];
+  int path_y[length];
+  int path_dir[length];
+  unsigned int n = 1;
+  path_x[0] = x;
+  path_y[0] = y;
+  *cell(board, x, y) = 'o';
+  while (n < length) {
+    int start = rand_below(4);
+    int dir = -1;
+    for (int k = 0; k < 4; k++) {
+      int d = (start + k) % 4;
+      if (is_free(board, x + dx[d], y + dy[d])) {
+        dir = d;
+        break;
+      }
+    }
+    if (dir < 0) {
+      break;
+    }
+    path_dir[n - 1] = dir;
+    x += dx[dir];
+    y += dy[dir];
+    path_x[n] = x;
+    path_y[n] = y;
+    *cell(board, x, y) = 'o';
+    n += 1;
+  }
+  if (n < 2) {
+    *cell(board, path_x[0], path_y[0]) = ' ';
+    return false;
+  }
+
+  // The head must not point into a snake, or find_head would walk on into it
+  int head_dir = -1;
+  int start = rand_below(4);
+  for (int k = 0; k < 4; k++) {
+    int d = (start + k) % 4;
+    if (!is_snake_char(*cell(board, x + dx[d], y + dy[d]))) {
+      head_dir = d;
+      break;
+    }
+  }
+  if (head_dir < 0) {
+    for (unsigned int i = 0; i < n; i++) {
+      *cell(board, path_x[i], path_y[i]) = ' ';
+    }
+    return false;
+  }
+
+  // Reserve the square in front of the head so later snakes are not placed there
+  if (*cell(board, x + dx[head_dir], y + dy[head_dir]) == ' ') {
+    *cell(board, x + dx[head_dir], y + dy[head_dir]) = 'r';
+  }
+  *cell(board, path_x[0], path_y[0]) = tails[path_dir[0]];
+  for (unsigned int i = 1; i < n - 1; i++) {
+    *cell(board, path_x[i], path_y[i]) = bodies[path_dir[i]];
+  }
+  // Some snakes start out dead
+  *cell(board, x, y) = rand_below(8) == 0 ? 'x' : bodies[head_dir];
+  return true;
+}
+
+/*
+  Builds a random board. With fixed_shapes, half of the boards take the size and snake count of
+  one of the fixed-size engine's shapes instead, so that its specialized variants get exercised.
+*/
+board_t random_board(bool fixed_shapes) {
+  const fixed_size_t* shape = NULL;
+  if (fixed_shapes && rand_below(2) == 0) {
+    shape = &fixed_sizes[rand_below(num_fixed_sizes)];
+  }
+  board_t board;
+  board.width = shape != NULL ? shape->x_size : 5 + rand_below(36);
+  board.height = shape != NULL ? shape->y_size : 5 + rand_below(26);
+  board.cells = malloc((board.width + 1) * board.height + 1);
+  for (int y = 0; y < board.height; y++) {
+    for (int x = 0; x < board.width; x++) {
+      bool border = x == 0 || y == 0 || x == board.width - 1 || y == board.height - 1;
+      *cell(&board, x, y) = border ? '#' : ' ';
+    }
+    *cell(&board, board.width, y) = '\n';
+  }
+  board.cells[(board.width + 1) * board.height] = '\0';
+
+  unsigned int interior = (board.width - 2) * (board.height - 2);
+  unsigned int walls = rand_below(interior / 8 + 1);
+  for (unsigned int i = 0; i < walls; i++) {
+    *cell(&board, 1 + rand_below(board.width - 2), 1 + rand_below(board.height - 2)) = '#';
+  }
+  if (shape != NULL) {
+    // Snakes don't always fit where they are tried, so keep trying until there are enough
+    unsigned int placed = 0;
+    for (unsigned int tries = 0; placed < shape->num_snakes && tries < 1000; tries++) {
+      placed += add_random_snake(&board, 2 + interior / 10);
+    }
+  } else {
+    unsigned int snakes = 1 + rand_below(interior / 12 + 1);
+    for (unsigned int i = 0; i < snakes; i++) {
+      add_random_snake(&board, 2 + interior / 10);
+    }
+  }
+  unsigned int food = rand_below(interior / 10 + 1);
+  for (unsigned int i = 0; i < food; i++) {
+    int x = 1 + rand_below(board.width - 2);
+    int y = 1 + rand_below(board.height - 2);
+    if (is_free(&board, x, y)) {
+      *cell(&board, x, y) = '*';
+    }
+  }
+  for (char* c = board.cells; *c != '\0'; c++) {
+    if (*c == 'r') {
+      *c = ' ';
+    }
+  }
+  return board;
+}
+
+game_state_t* load_text(fuzz_t* fuzz, board_t* board) {
+  FILE* f = fopen(fuzz->scratch_filename, "w");
+  fputs(board->cells, f);
+  fclose(f);
+  return initialize_snakes(load_board(fuzz->scratch_filename));
+}
+
+bool states_match(game_state_t* expected, game_state_t* actual, char* why, size_t why_size) {
+  if (actual->hash != board_hash(actual)) {
+    snprintf(why, why_size, "candidate hash is stale");
+    return false;
+  }
+  for (unsigned int y = 0; y < expected->y_size; y++) {
+    if (memcmp(expected->board[y], actual->board[y], expected->x_size) != 0) {
+      snprintf(why, why_size, "boards differ in row %u", y);
+      return false;
+    }
+  }
+  if (expected->num_snakes != actual->num_snakes) {
+    snprintf(why, why_size, "snake counts differ");
+    return false;
+  }
+  for (unsigned int i = 0; i < expected->num_snakes; i++) {
+    snake_t* a = &expected->snakes[i];
+    snake_t* b = &actual->snakes[i];
+    if (a->head_x != b->head_x || a->head_y != b->head_y || a->tail_x != b->tail_x || a->tail_y != b->tail_y
+        || a->live != b->live) {
+      snprintf(why, why_size, "snake %u differs", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Runs both engines on board for up to max_ticks ticks. Returns the first tick after which they
+  disagree, or 0 if they never do.
+*/
+unsigned long run_board(fuzz_t* fuzz, board_t* board, unsigned long max_ticks, char* why, size_t why_size) {
+  game_state_t* reference = load_text(fuzz, board);
+  game_state_t* loaded = load_text(fuzz, board);
+  game_state_t* candidate = fuzz->engine->start(loaded);
+  uint32_t reference_seed = 1;
+  uint32_t candidate_seed = 1;
+  unsigned long diverged = 0;
+
+  for (unsigned long tick = 1; tick <= max_ticks; tick++) {
+    if (reference->num_live == 0) {
+      break;
+    }
+
+    seed = reference_seed;
+    double start = now_ns();
+    update_state(reference, fuzz_food);
+    fuzz->reference_ns += now_ns() - start;
+    reference_seed = seed;
+
+    seed = candidate_seed;
+    step_failure = NULL;
+    start = now_ns();
+    candidate = fuzz->engine->step(candidate, fuzz_food);
+    fuzz->candidate_ns += now_ns() - start;
+    candidate_seed = seed;
+    fuzz->ticks += 1;
+
+    if (step_failure != NULL) {
+      snprintf(why, why_size, "%s", step_failure);
+      diverged = tick;
+      break;
+    }
+    if (!states_match(reference, candidate, why, why_size)) {
+      diverged = tick;
+      break;
+    }
+    if (reference_seed != candidate_seed) {
+      snprintf(why, why_size, "food seeds differ");
+      diverged = tick;
+      break;
+    }
+  }
+
+  free_state(reference);
+  free_state(candidate);
+  if (candidate != loaded) {
+    free_state(loaded);
+  }
+  return diverged;
+}
+
+/* Replaces the cells of the snake whose tail is at (x, y) with spaces. */
+void erase_snake(board_t* board, int x, int y) {
+  while (is_snake_char(*cell(board, x, y))) {
+    char c = *cell(board, x, y);
+    *cell(board, x, y) = ' ';
+    if (c == 'w' || c == '^') {
+      y -= 1;
+    } else if (c == 'a' || c == '<') {
+      x -= 1;
+    } else if (c == 's' || c == 'v') {
+      y += 1;
+    } else if (c == 'd' || c == '>') {
+      x += 1;
+    } else {
+      break;
+    }
+  }
+}
+
+/*
+  Greedily simplifies a diverging board: removes whole snakes, then food, then interior walls, then
+  shortens the run, keeping each change only if the engines still disagree.
+*/
+unsigned long shrink(fuzz_t* fuzz, board_t* board, unsigned long ticks) {
+  char why[128];
+  size_t size = (board->width + 1) * board->height + 1;
+  char* saved = malloc(size);
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (int y = 1; y < board->height - 1; y++) {
+      for (int x = 1; x < board->width - 1; x++) {
+        char c = *cell(board, x, y);
+        if (c == ' ') {
+          continue;
+        }
+        memcpy(saved, board->cells, size);
+        if (c == 'w' || c == 'a' || c == 's' || c == 'd') {
+          erase_snake(board, x, y);
+        } else if (c == '*' || c == '#') {
+          *cell(board, x, y) = ' ';
+        } else {
+          continue;
+        }
+        unsigned long diverged = run_board(fuzz, board, ticks, why, sizeof(why));
+        if (diverged != 0) {
+          ticks = diverged;
+          progress = true;
+        } else {
+          memcpy(board->cells, saved, size);
+        }
+      }
+    }
+  }
+  free(saved);
+  return ticks;
+}
+
+int main(int argc, char* argv[]) {
+  unsigned long total_ticks = 1000000;
+  const char* engine_name = "cow";
+  const char* repro_filename = "fuzz-repro.snk";
+  fuzz_t fuzz;
+  memset(&fuzz, 0, sizeof(fuzz));
+  fuzz.max_ticks = 200;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i < argc - 1) {
+      total_ticks = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+      fuzz.max_ticks = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-s") == 0 && i < argc - 1) {
+      fuzz_seed = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-e") == 0 && i < argc - 1) {
+      engine_name = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-o") == 0 && i < argc - 1) {
+      repro_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s [-n total ticks] [-t ticks per board] [-s seed] [-e engine] [-o repro filename]\n",
+            argv[0]);
+    fprintf(stderr, "Engines:\n");
+    for (int j = 0; j < NUM_ENGINES; j++) {
+      fprintf(stderr, "  %-8s %s\n", engines[j].name, engines[j].description);
+    }
+    return 1;
+  }
+
+  for (int j = 0; j < NUM_ENGINES; j++) {
+    if (strcmp(engines[j].name, engine_name) == 0) {
+      fuzz.engine = &engines[j];
+    }
+  }
+  if (fuzz.engine == NULL) {
+    fprintf(stderr, "Unknown engine %s\n", engine_name);
+    return 1;
+  }
+  snprintf(fuzz.scratch_filename, sizeof(fuzz.scratch_filename), "/tmp/snake-fuzz-%ld.snk", (long) getpid());
+
+  int status = 0;
+  while (fuzz.ticks < total_ticks) {
+    uint32_t board_seed = fuzz_seed;
+    board_t board = random_board(fuzz.engine->fixed_shapes);
+    fuzz.boards += 1;
+    char why[128];
+    unsigned long diverged = run_board(&fuzz, &board, fuzz.max_ticks, why, sizeof(why));
+    if (diverged != 0) {
+      fprintf(stderr, "Board %lu (seed %u) diverged after tick %lu: %s\n", fuzz.boards, board_seed, diverged, why);
+      unsigned long ticks = shrink(&fuzz, &board, diverged);
+      FILE* f = fopen(repro_filename, "w");
+      fputs(board.cells, f);
+      fclose(f);
+      fprintf(stderr, "Shrunk repro written to %s (diverges after %lu ticks)\n", repro_filename, ticks);
+      free(board.cells);
+      status = 1;
+      break;
+    }
+    free(board.cells);
+  }
+  unlink(fuzz.scratch_filename);
+
+  printf("%lu boards, %lu ticks\n", fuzz.boards, fuzz.ticks);
+  printf("  reference %12.0f ticks/s\n", fuzz.ticks / (fuzz.reference_ns / 1e9));
+  printf("  %-9s %12.0f ticks/s\n", fuzz.engine->name, fuzz.ticks / (fuzz.candidate_ns / 1e9));
+  return status;
+}
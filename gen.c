@@ -0,0 +1,296 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Synthetic board generator. Boards are written one row at a time, so memory use depends on the
+  row width and the number of snakes, never on the board area.
+
+  Every snake is a straight line that lives in its own square tile of the interior, with a free
+  margin around it, so snakes never overlap or point into each other. Tiles are handed out by a
+  seeded permutation, and every row draws its food and walls from a generator seeded by the row
+  number, so the same options always produce the same board.
+*/
+
+typedef enum wall_pattern_t {
+  WALLS_BORDER,
+  WALLS_RANDOM,
+  WALLS_PILLARS,
+  WALLS_ROOMS
+} wall_pattern_t;
+
+typedef struct gen_snake_t {
+  uint64_t tile;
+  unsigned int x;
+  unsigned int y;
+  unsigned int length;
+  // Index into "wasd": the direction the snake is moving in
+  unsigned int dir;
+} gen_snake_t;
+
+typedef struct gen_options_t {
+  uint64_t width;
+  uint64_t height;
+  uint64_t num_snakes;
+  unsigned int min_length;
+  unsigned int max_length;
+  double food_density;
+  wall_pattern_t walls;
+  double wall_density;
+  unsigned int wall_spacing;
+  uint64_t seed;
+} gen_options_t;
+
+static const char* tails = "wasd";
+static const char* bodies = "^<v>";
+static const int dx[] = {0, -1, 0, 1};
+static const int dy[] = {-1, 0, 1, 0};
+
+uint64_t mix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t next_rand(uint64_t* state) {
+  *state += 0x9E3779B97F4A7C15ULL;
+  uint64_t z = *state;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*
+  A seeded permutation of [0, n): a bijection on the smallest power of two >= n, applied
+  repeatedly until the result lands back inside the range (cycle walking).
+*/
+uint64_t permute(uint64_t i, uint64_t n, uint64_t seed) {
+  unsigned int bits = 1;
+  while (bits < 64 && ((uint64_t) 1 << bits) < n) {
+    bits += 1;
+  }
+  uint64_t mask = bits == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << bits) - 1;
+  uint64_t a = (mix(seed) | 1) & mask;
+  uint64_t c = mix(seed + 1) & mask;
+  do {
+    i = (i * a + c) & mask;
+    i ^= i >> (bits / 2 + 1);
+    i = (i * 0xD6E8FEB86659FD93ULL) & mask;
+    i ^= i >> (bits / 2 + 1);
+  } while (i >= n);
+  return i;
+}
+
+int compare_snakes(const void* a, const void* b) {
+  const gen_snake_t* sa = a;
+  const gen_snake_t* sb = b;
+  return sa->tile < sb->tile ? -1 : sa->tile > sb->tile;
+}
+
+bool is_wall(gen_options_t* options, uint64_t x, uint64_t y, uint64_t* rng) {
+  if (x == 0 || y == 0 || x == options->width - 1 || y == options->height - 1) {
+    return true;
+  }
+  unsigned int k = options->wall_spacing;
+  switch (options->walls) {
+    case WALLS_RANDOM:
+      return (next_rand(rng) >> 11) * (1.0 / 9007199254740992.0) < options->wall_density;
+    case WALLS_PILLARS:
+      return x % k == 0 && y % k == 0;
+    case WALLS_ROOMS:
+      // Walls every k cells, with a doorway in the middle of each wall segment
+      return (x % k == 0 && y % k != k / 2) || (y % k == 0 && x % k != k / 2);
+    default:
+      return false;
+  }
+}
+
+int generate(gen_options_t* options, FILE* out) {
+  uint64_t width = options->width;
+  uint64_t height = options->height;
+
+  // Each tile fits the longest snake plus a free cell at both ends and on both sides
+  uint64_t tile_size = options->max_length + 2;
+  uint64_t tiles_x = (width - 2) / tile_size;
+  uint64_t tiles_y = (height - 2) / tile_size;
+  uint64_t num_tiles = tiles_x * tiles_y;
+  if (options->num_snakes > num_tiles) {
+    fprintf(stderr, "Board too small for %llu snakes of length up to %u (room for %llu)\n",
+            (unsigned long long) options->num_snakes, options->max_length, (unsigned long long) num_tiles);
+    return 1;
+  }
+
+  gen_snake_t* snakes = malloc((options->num_snakes + 1) * sizeof(gen_snake_t));
+  uint64_t rng = options->seed;
+  for (uint64_t i = 0; i < options->num_snakes; i++) {
+    gen_snake_t* snake = &snakes[i];
+    snake->tile = permute(i, num_tiles, options->seed);
+    snake->length = options->min_length + next_rand(&rng) % (options->max_length - options->min_length + 1);
+    snake->dir = next_rand(&rng) % 4;
+    // Place the head inside the tile so that the tail and the square in front of the head both stay
+    // within it. The outermost ring of the tile never holds a snake.
+    uint64_t tile_x = 1 + (snake->tile % tiles_x) * tile_size;
+    uint64_t tile_y = 1 + (snake->tile / tiles_x) * tile_size;
+    unsigned int along = snake->length + next_rand(&rng) % (tile_size - snake->length - 1);
+    unsigned int across = 1 + next_rand(&rng) % (tile_size - 2);
+    if (dx[snake->dir] != 0) {
+      snake->x = tile_x + (dx[snake->dir] > 0 ? along : tile_size - 1 - along);
+      snake->y = tile_y + across;
+    } else {
+      snake->x = tile_x + across;
+      snake->y = tile_y + (dy[snake->dir] > 0 ? along : tile_size - 1 - along);
+    }
+  }
+  qsort(snakes, options->num_snakes, sizeof(gen_snake_t), compare_snakes);
+  snakes[options->num_snakes].tile = UINT64_MAX;
+
+  char* row = malloc(width + 1);
+  row[width] = '\n';
+  uint64_t food_threshold = (uint64_t) (options->food_density * 65536.0);
+  uint64_t first = 0;
+  for (uint64_t y = 0; y < height; y++) {
+    uint64_t row_rng = mix(options->seed ^ mix(y));
+
+    for (uint64_t x = 0; x < width; x++) {
+      row[x] = is_wall(options, x, y, &row_rng) ? '#' : ' ';
+    }
+    if (food_threshold > 0) {
+      for (uint64_t x = 1; x + 1 < width; x += 4) {
+        uint64_t r = next_rand(&row_rng);
+        for (uint64_t k = 0; k < 4 && x + k + 1 < width; k++) {
+          if (((r >> (16 * k)) & 0xFFFF) < food_threshold && row[x + k] == ' ') {
+            row[x + k] = '*';
+          }
+        }
+      }
+    }
+
+    // Snakes in the current band of tiles are a contiguous run of the sorted array
+    if (tiles_y > 0 && y >= 1 && (y - 1) / tile_size < tiles_y) {
+      uint64_t band = (y - 1) / tile_size;
+      while (snakes[first].tile < band * tiles_x) {
+        first += 1;
+      }
+      for (uint64_t i = first; snakes[i].tile < (band + 1) * tiles_x; i++) {
+        gen_snake_t* snake = &snakes[i];
+        for (unsigned int k = 0; k < snake->length; k++) {
+          // Segment k counts from the tail; x, y is the head
+          int64_t cx = (int64_t) snake->x - (int64_t) (snake->length - 1 - k) * dx[snake->dir];
+          int64_t cy = (int64_t) snake->y - (int64_t) (snake->length - 1 - k) * dy[snake->dir];
+          if (cy == y) {
+            row[cx] = k == 0 ? tails[snake->dir] : bodies[snake->dir];
+          }
+        }
+        // Keep the square in front of the head clear
+        int64_t fx = (int64_t) snake->x + dx[snake->dir];
+        int64_t fy = (int64_t) snake->y + dy[snake->dir];
+        if (fy == y && row[fx] == '*') {
+          row[fx] = ' ';
+        }
+      }
+    }
+
+    if (fwrite(row, 1, width + 1, out) != width + 1) {
+      perror("Error writing board");
+      free(row);
+      free(snakes);
+      return 1;
+    }
+  }
+
+  free(row);
+  free(snakes);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  gen_options_t options;
+  options.width = 14;
+  options.height = 10;
+  options.num_snakes = 1;
+  options.min_length = 2;
+  options.max_length = 2;
+  options.food_density = 0.01;
+  options.walls = WALLS_BORDER;
+  options.wall_density = 0.02;
+  options.wall_spacing = 16;
+  options.seed = 1;
+  char* out_filename = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (i < argc - 1) {
+      char* value = argv[i + 1];
+      bool matched = true;
+      if (strcmp(argv[i], "-w") == 0) {
+        options.width = strtoull(value, NULL, 10);
+      } else if (strcmp(argv[i], "-h") == 0) {
+        options.height = strtoull(value, NULL, 10);
+      } else if (strcmp(argv[i], "-n") == 0) {
+        options.num_snakes = strtoull(value, NULL, 10);
+      } else if (strcmp(argv[i], "-l") == 0) {
+        // Either a fixed length or min:max, drawn uniformly
+        char* end;
+        options.min_length = strtoul(value, &end, 10);
+        options.max_length = *end == ':' ? strtoul(end + 1, NULL, 10) : options.min_length;
+      } else if (strcmp(argv[i], "-f") == 0) {
+        options.food_density = strtod(value, NULL);
+      } else if (strcmp(argv[i], "-W") == 0) {
+        if (strcmp(value, "border") == 0) {
+          options.walls = WALLS_BORDER;
+        } else if (strcmp(value, "random") == 0) {
+          options.walls = WALLS_RANDOM;
+        } else if (strcmp(value, "pillars") == 0) {
+          options.walls = WALLS_PILLARS;
+        } else if (strcmp(value, "rooms") == 0) {
+          options.walls = WALLS_ROOMS;
+        } else {
+          matched = false;
+        }
+      } else if (strcmp(argv[i], "-d") == 0) {
+        options.wall_density = strtod(value, NULL);
+      } else if (strcmp(argv[i], "-k") == 0) {
+        options.wall_spacing = strtoul(value, NULL, 10);
+      } else if (strcmp(argv[i], "-s") == 0) {
+        options.seed = strtoull(value, NULL, 10);
+      } else if (strcmp(argv[i], "-o") == 0) {
+        out_filename = value;
+      } else {
+        matched = false;
+      }
+      if (matched) {
+        i++;
+        continue;
+      }
+    }
+    fprintf(stderr,
+            "Usage: %s [-w width] [-h height] [-n snakes] [-l length or min:max] [-f food density]\n"
+            "       [-W border|random|pillars|rooms] [-d wall density] [-k wall spacing] [-s seed] [-o filename]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (options.width < 3 || options.height < 3 || options.min_length < 2 || options.max_length < options.min_length
+      || options.wall_spacing < 2) {
+    fprintf(stderr, "Boards must be at least 3x3, snakes at least 2 long, and walls at least 2 apart\n");
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if (out_filename != NULL) {
+    out = fopen(out_filename, "w");
+    if (out == NULL) {
+      perror("Error opening output file");
+      return 1;
+    }
+  }
+  setvbuf(out, NULL, _IOFBF, 1 << 20);
+  int status = generate(&options, out);
+  if (fclose(out) != 0) {
+    perror("Error writing board");
+    status = 1;
+  }
+  return status;
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+#include "snake_utils.h"
+
+static history_entry_t* entry_at(history_t* history, size_t i) {
+  return &history->entries[(history->start + i) % history->capacity];
+}
+
+/* Drops the oldest tick to make room. */
+static void evict_oldest(history_t* history) {
+  history->start = (history->start + 1) % history->capacity;
+  history->count -= 1;
+  history->num_ticks -= 1;
+  while (history->count > 0 && entry_at(history, 0)->kind != HISTORY_TICK) {
+    history->start = (history->start + 1) % history->capacity;
+    history->count -= 1;
+  }
+}
+
+static void push(history_t* history, history_entry_t* entry) {
+  if (history->overflowed) {
+    return;
+  }
+  if (history->count == history->capacity) {
+    evict_oldest(history);
+    if (history->count == 0) {
+      // A single tick changed more cells than the buffer holds, so it can't be rewound
+      history->overflowed = true;
+      return;
+    }
+  }
+  *entry_at(history, history->count) = *entry;
+  history->count += 1;
+}
+
+static void record_cell(game_state_t* state, int x, int y, char old_ch, char new_ch, void* ctx) {
+  history_t* history = ctx;
+  if (history->rewinding || history->num_ticks == 0) {
+    return;
+  }
+  history_entry_t entry;
+  entry.kind = HISTORY_CELL;
+  entry.u.cell.x = x;
+  entry.u.cell.y = y;
+  entry.u.cell.ch = old_ch;
+  push(history, &entry);
+}
+
+history_t* history_create(game_state_t* state, size_t capacity) {
+  history_t* history = malloc(sizeof(history_t));
+  history->entries = malloc(capacity * sizeof(history_entry_t));
+  history->capacity = capacity;
+  history->start = 0;
+  history->count = 0;
+  history->num_ticks = 0;
+  history->num_snakes = state->num_snakes;
+  history->snakes_before = malloc(state->num_snakes * sizeof(snake_t));
+  history->rewinding = false;
+  history->overflowed = false;
+  watch_board(state, record_cell, history);
+  return history;
+}
+
+void history_destroy(history_t* history, game_state_t* state) {
+  unwatch_board(state, record_cell, history);
+  free(history->snakes_before);
+  free(history->entries);
+  free(history);
+}
+
+/* Starts recording a tick. Changes made before the next call belong to this tick. */
+void history_begin_tick(history_t* history, game_state_t* state, unsigned int timestep) {
+  history->overflowed = false;
+  history_entry_t entry;
+  entry.kind = HISTORY_TICK;
+  entry.u.tick.seed = seed;
+  entry.u.tick.snake_seed = snake_seed;
+  entry.u.tick.timestep = timestep;
+  if (history->count == history->capacity) {
+    evict_oldest(history);
+  }
+  *entry_at(history, history->count) = entry;
+  history->count += 1;
+  history->num_ticks += 1;
+  memcpy(history->snakes_before, state->snakes, history->num_snakes * sizeof(snake_t));
+}
+
+/* Records the snakes that changed since history_begin_tick. */
+void history_end_tick(history_t* history, game_state_t* state) {
+  for (unsigned int i = 0; i < history->num_snakes; i++) {
+    if (memcmp(&history->snakes_before[i], &state->snakes[i], sizeof(snake_t)) != 0) {
+      history_entry_t entry;
+      entry.kind = HISTORY_SNAKE;
+      entry.u.snake.snum = i;
+      entry.u.snake.snake = history->snakes_before[i];
+      push(history, &entry);
+    }
+  }
+}
+
+/*
+  Undoes the most recent tick, including any redirects made after it, and restores the random
+  state and timestep it started with. Returns false if there is nothing left to rewind.
+*/
+bool history_rewind(history_t* history, game_state_t* state, unsigned int* timestep) {
+  if (history->num_ticks == 0) {
+    return false;
+  }
+  history->rewinding = true;
+  while (history->count > 0) {
+    history->count -= 1;
+    history_entry_t* entry = entry_at(history, history->count);
+    if (entry->kind == HISTORY_TICK) {
+      seed = entry->u.tick.seed;
+      snake_seed = entry->u.tick.snake_seed;
+      *timestep = entry->u.tick.timestep;
+      break;
+    } else if (entry->kind == HISTORY_CELL) {
+      set_board_at(state, entry->u.cell.x, entry->u.cell.y, entry->u.cell.ch);
+    } else {
+      state->snakes[entry->u.snake.snum] = entry->u.snake.snake;
+    }
+  }
+  // Rewinding past a death brings the snake back to life
+  refresh_live_snakes(state);
+  history->num_ticks -= 1;
+  history->overflowed = false;
+  history->rewinding = false;
+  return true;
+}
@@ -0,0 +1,65 @@
+#ifndef _SNK_HISTORY_H
+#define _SNK_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "state.h"
+
+/*
+  A fixed-size undo log for a running game. Each tick is recorded as a marker holding the random
+  state and timestep at the start of the tick, followed by the old value of every cell and snake
+  that changed during it. When the buffer is full the oldest ticks are dropped, so memory use does
+  not depend on how long the game runs.
+*/
+typedef enum history_kind_t {
+  HISTORY_TICK,
+  HISTORY_CELL,
+  HISTORY_SNAKE
+} history_kind_t;
+
+typedef struct history_entry_t {
+  history_kind_t kind;
+  union {
+    struct {
+      uint32_t seed;
+      uint32_t snake_seed;
+      unsigned int timestep;
+    } tick;
+    struct {
+      unsigned int x;
+      unsigned int y;
+      char ch;
+    } cell;
+    struct {
+      unsigned int snum;
+      snake_t snake;
+    } snake;
+  } u;
+} history_entry_t;
+
+typedef struct history_t {
+  history_entry_t* entries;
+  size_t capacity;
+  size_t start;
+  size_t count;
+
+  // Number of complete ticks that can currently be rewound
+  unsigned int num_ticks;
+
+  // Snake table at the start of the current tick, used to find the snakes that changed
+  snake_t* snakes_before;
+  unsigned int num_snakes;
+
+  bool rewinding;
+
+  // Set when the current tick did not fit in the buffer, until the next tick starts
+  bool overflowed;
+} history_t;
+
+history_t* history_create(game_state_t* state, size_t capacity);
+void history_destroy(history_t* history, game_state_t* state);
+void history_begin_tick(history_t* history, game_state_t* state, unsigned int timestep);
+void history_end_tick(history_t* history, game_state_t* state);
+bool history_rewind(history_t* history, game_state_t* state, unsigned int* timestep);
+
+#endif
@@ -5,17 +5,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
+#include "autopilot.h"
+#include "frame_ring.h"
+#include "history.h"
+#include "replay.h"
 #include "snake_utils.h"
 #include "state.h"
+#include "stats.h"
 
 // This code uses some pretty bad hacks, and should not be used as a "good" reference.
 
 struct timespec game_interval = {1, 0L};
 game_state_t* state = NULL;
 pthread_mutex_t state_mutex;
+history_t* history = NULL;
+unsigned int timestep = 0;
+bool paused = false;
+// Spectators' view of the game, if -p was given
+frame_ring_t* ring = NULL;
+// Steers the non-player snakes towards food, if -a was given
+autopilot_t* autopilot = NULL;
+// Records the game, if -r was given. Rewinding is off while recording.
+replay_writer_t* replay = NULL;
 
 // Adapted from https://stackoverflow.com/a/912796
 int get_raw_char() {
@@ -46,38 +61,94 @@ int get_raw_char() {
   return (int) (unsigned char) buf;
 }
 
+/* First row or column of a viewport of the given size centered on center, kept inside the board. */
+unsigned int viewport_start(unsigned int center, unsigned int view_size, unsigned int board_size) {
+  if (view_size >= board_size || center < view_size / 2) {
+    return 0;
+  }
+  unsigned int start = center - view_size / 2;
+  return start + view_size > board_size ? board_size - view_size : start;
+}
+
+/*
+  Draws the part of the board that fits in the terminal, centered on the player's head, so the
+  cost depends on the terminal size rather than the board size. When stdout is not a terminal the
+  whole board is drawn.
+*/
 void print_fullscreen_board(game_state_t* state) {
+  struct winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0 || ws.ws_row < 2) {
+    fprintf(stdout, "\033[2J\033[H");
+    print_board(state, stdout);
+    return;
+  }
+
+  // The last terminal line is left free so the cursor doesn't scroll the screen
+  unsigned int view_x = ws.ws_col < state->x_size ? ws.ws_col : state->x_size;
+  unsigned int view_y = ws.ws_row - 1u < state->y_size ? ws.ws_row - 1u : state->y_size;
+  unsigned int center_x = state->x_size / 2;
+  unsigned int center_y = state->y_size / 2;
+  if (state->num_snakes > 0) {
+    center_x = state->snakes[0].head_x;
+    center_y = state->snakes[0].head_y;
+  }
+  unsigned int left = viewport_start(center_x, view_x, state->x_size);
+  unsigned int top = viewport_start(center_y, view_y, state->y_size);
+
   fprintf(stdout, "\033[2J\033[H");
-  print_board(state, stdout);
+  for (unsigned int y = top; y < top + view_y; y++) {
+    fwrite(state->board[y] + left, 1, view_x, stdout);
+    fputc('\n', stdout);
+  }
+  fflush(stdout);
 }
 
 void* game_loop(void* _) {
-  unsigned int timestep = 0;
   print_fullscreen_board(state);
 
   while (1) {
     nanosleep(&game_interval, NULL);
 
     pthread_mutex_lock(&state_mutex);
-    int live_snakes = 0;
-    // non-player controlled snakes randomly turn every 6 steps
-    for (int j = 0; j < state->num_snakes; j++) {
-      if (state->snakes[j].live) {
-        live_snakes += 1;
-        if (j >= 1 && timestep % 6 == 0) {
-          random_turn(state, j);
-        }
+    if (paused) {
+      pthread_mutex_unlock(&state_mutex);
+      continue;
+    }
+    history_begin_tick(history, state, timestep);
+    unsigned int live_snakes = state->num_live;
+    // non-player controlled snakes randomly turn every 6 steps, or head for food with -a
+    if (autopilot != NULL) {
+      autopilot_update(autopilot);
+    }
+    for (unsigned int k = 0; k < state->num_live; k++) {
+      int j = state->live_snakes[k];
+      if (j >= 1 && autopilot != NULL) {
+        autopilot_steer(autopilot, j);
+      } else if (j >= 1 && timestep % 6 == 0) {
+        random_turn(state, j);
       }
     }
+    if (replay != NULL) {
+      // Don't let the game be cancelled halfway through writing a block
+      int cancel_state;
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+      replay_record_tick(replay, state);
+      pthread_setcancelstate(cancel_state, NULL);
+    }
     update_state(state, deterministic_food);
-    pthread_mutex_unlock(&state_mutex);
-
-    print_fullscreen_board(state);
+    history_end_tick(history, state);
     timestep += 1;
+    if (ring != NULL) {
+      frame_ring_publish(ring, state, timestep);
+    }
 
+    // Once every snake is dead, stop ticking but stay rewindable
     if (live_snakes == 0) {
-      break;
+      paused = true;
     }
+    pthread_mutex_unlock(&state_mutex);
+
+    print_fullscreen_board(state);
   }
 
   return NULL;
@@ -85,9 +156,24 @@ void* game_loop(void* _) {
 
 void input_loop() {
   while (1) {
-    char key = get_raw_char();
+    int key = get_raw_char();
+    if (key == KEY_QUIT || key == EOF) {
+      return;
+    }
     pthread_mutex_lock(&state_mutex);
-    redirect_snake(state, key);
+    if (key == KEY_REWIND && replay == NULL) {
+      // Rewinding pauses the game; steering the snake resumes it
+      history_rewind(history, state, &timestep);
+      paused = true;
+    } else {
+      if (key == KEY_MOVEUP || key == KEY_MOVELEFT || key == KEY_MOVEDOWN || key == KEY_MOVERIGHT) {
+        paused = false;
+      }
+      redirect_snake(state, key);
+    }
+    if (ring != NULL) {
+      frame_ring_publish(ring, state, timestep);
+    }
     pthread_mutex_unlock(&state_mutex);
     print_fullscreen_board(state);
   }
@@ -95,6 +181,11 @@ void input_loop() {
 
 int main(int argc, char* argv[]) {
   char* in_filename = NULL;
+  size_t history_size = 65536;
+  bool print_stats = false;
+  char* ring_name = NULL;
+  bool use_autopilot = false;
+  char* replay_filename = NULL;
 
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-i") == 0 && i < argc - 1) {
@@ -112,22 +203,88 @@ int main(int argc, char* argv[]) {
       i++;
       continue;
     }
-    fprintf(stderr, "Usage: %s [-i filename] [-d delay]\n", argv[0]);
+    if (strcmp(argv[i], "-b") == 0 && i < argc - 1) {
+      history_size = strtoul(argv[i + 1], NULL, 10);
+      if (history_size == 0) {
+        history_size = 1;
+      }
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-p") == 0 && i < argc - 1) {
+      ring_name = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+      replay_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-a") == 0) {
+      use_autopilot = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--stats") == 0) {
+      print_stats = true;
+      continue;
+    }
+    fprintf(stderr,
+            "Usage: %s [-i filename] [-d delay] [-b history entries] [-p frame ring name] [-r replay filename] [-a] "
+            "[--stats]\n",
+            argv[0]);
     return 1;
   }
 
   // Read board from file, or create default board
   if (in_filename != NULL) {
     state = load_board(in_filename);
+    if (state == NULL) {
+      return 1;
+    }
     state = initialize_snakes(state);
   } else {
     state = create_default_state();
   }
+  history = history_create(state, history_size);
+  if (use_autopilot) {
+    autopilot = autopilot_create(state);
+  }
+  if (ring_name != NULL) {
+    ring = frame_ring_create(ring_name, state->x_size, state->y_size, FRAME_RING_SLOTS);
+    if (ring == NULL) {
+      return 1;
+    }
+    frame_ring_publish(ring, state, timestep);
+  }
+  if (replay_filename != NULL) {
+    replay = replay_writer_create(replay_filename, state, REPLAY_KEYFRAME_TICKS);
+    if (replay == NULL) {
+      return 1;
+    }
+  }
 
   pthread_t thread_id;
   pthread_create(&thread_id, NULL, game_loop, NULL);
   input_loop();
   pthread_cancel(thread_id);
+  pthread_join(thread_id, NULL);
+  if (ring != NULL) {
+    frame_ring_destroy(ring);
+  }
+  if (replay != NULL) {
+    int error = replay_writer_close(replay);
+    if (error != 0) {
+      fprintf(stderr, "Error writing replay %s: %s\n", replay_filename, strerror(error));
+    }
+  }
+  if (autopilot != NULL) {
+    autopilot_destroy(autopilot);
+  }
+
+  if (print_stats) {
+    stats_dump_json(stderr);
+  }
 
   return 0;
 }
@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "parallel.h"
+
+#define MAX_THREADS 64
+
+typedef struct parallel_job_t {
+  parallel_fn_t fn;
+  void* ctx;
+  unsigned int chunk;
+  size_t begin;
+  size_t end;
+} parallel_job_t;
+
+// Tasks a worker still has to run: it takes them from the front, thieves take them from the back
+typedef struct parallel_deque_t {
+  pthread_mutex_t lock;
+  size_t begin;
+  size_t end;
+} parallel_deque_t;
+
+typedef struct parallel_pool_t {
+  parallel_task_t fn;
+  void* ctx;
+  unsigned int workers;
+  parallel_deque_t deques[MAX_THREADS];
+} parallel_pool_t;
+
+// 0 means one thread per online CPU
+static unsigned int num_threads = 0;
+
+/* Overrides the number of threads. 0 goes back to the default of one per online CPU. */
+void parallel_set_threads(unsigned int threads) {
+  num_threads = threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+/* Number of chunks to split count items into, so that no chunk has fewer than grain items. */
+unsigned int parallel_chunks(size_t count, size_t grain) {
+  unsigned int threads = num_threads;
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online < 1 ? 1 : online > MAX_THREADS ? MAX_THREADS : (unsigned int) online;
+  }
+  size_t chunks = grain == 0 ? count : count / grain;
+  if (chunks > threads) {
+    chunks = threads;
+  }
+  return chunks < 1 ? 1 : (unsigned int) chunks;
+}
+
+static void* run_job(void* arg) {
+  parallel_job_t* job = arg;
+  job->fn(job->chunk, job->begin, job->end, job->ctx);
+  return NULL;
+}
+
+void parallel_run(unsigned int chunks, size_t count, parallel_fn_t fn, void* ctx) {
+  if (chunks > MAX_THREADS) {
+    chunks = MAX_THREADS;
+  }
+  parallel_job_t jobs[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  bool started[MAX_THREADS];
+  for (unsigned int c = 0; c < chunks; c++) {
+    jobs[c].fn = fn;
+    jobs[c].ctx = ctx;
+    jobs[c].chunk = c;
+    jobs[c].begin = count * c / chunks;
+    jobs[c].end = count * (c + 1) / chunks;
+  }
+  for (unsigned int c = 1; c < chunks; c++) {
+    started[c] = pthread_create(&threads[c], NULL, run_job, &jobs[c]) == 0;
+  }
+  run_job(&jobs[0]);
+  for (unsigned int c = 1; c < chunks; c++) {
+    // Chunks that couldn't get a thread run here instead
+    if (started[c]) {
+      pthread_join(threads[c], NULL);
+    } else {
+      run_job(&jobs[c]);
+    }
+  }
+}
+
+/* Number of workers parallel_steal uses for count tasks. */
+unsigned int parallel_workers(size_t count) {
+  return parallel_chunks(count, 1);
+}
+
+/* Takes the next task from the front of deque. Returns false if it is empty. */
+static bool take(parallel_deque_t* deque, size_t* task) {
+  pthread_mutex_lock(&deque->lock);
+  bool found = deque->begin < deque->end;
+  if (found) {
+    *task = deque->begin;
+    deque->begin += 1;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+/* Moves the back half of another worker's tasks to worker's deque. Returns false if none are left. */
+static bool steal(parallel_pool_t* pool, unsigned int worker) {
+  for (unsigned int i = 1; i < pool->workers; i++) {
+    parallel_deque_t* victim = &pool->deques[(worker + i) % pool->workers];
+    pthread_mutex_lock(&victim->lock);
+    size_t left = victim->end - victim->begin;
+    size_t end = victim->end;
+    victim->end -= (left + 1) / 2;
+    size_t begin = victim->end;
+    pthread_mutex_unlock(&victim->lock);
+    if (begin < end) {
+      parallel_deque_t* deque = &pool->deques[worker];
+      pthread_mutex_lock(&deque->lock);
+      deque->begin = begin;
+      deque->end = end;
+      pthread_mutex_unlock(&deque->lock);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void run_worker(parallel_pool_t* pool, unsigned int worker) {
+  size_t task;
+  do {
+    while (take(&pool->deques[worker], &task)) {
+      pool->fn(worker, task, pool->ctx);
+    }
+  } while (steal(pool, worker));
+}
+
+static void steal_job(unsigned int chunk, size_t begin, size_t end, void* ctx) {
+  run_worker(ctx, chunk);
+}
+
+void parallel_steal(size_t count, parallel_task_t fn, void* ctx) {
+  parallel_pool_t pool;
+  pool.fn = fn;
+  pool.ctx = ctx;
+  pool.workers = parallel_workers(count);
+  for (unsigned int w = 0; w < pool.workers; w++) {
+    pthread_mutex_init(&pool.deques[w].lock, NULL);
+    pool.deques[w].begin = count * w / pool.workers;
+    pool.deques[w].end = count * (w + 1) / pool.workers;
+  }
+  parallel_run(pool.workers, pool.workers, steal_job, &pool);
+  for (unsigned int w = 0; w < pool.workers; w++) {
+    pthread_mutex_destroy(&pool.deques[w].lock);
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef _SNK_PARALLEL_H
+#define _SNK_PARALLEL_H
+
+#include <stddef.h>
+
+/*
+  Splits count items into contiguous chunks and runs fn on each chunk on its own thread, with the
+  first chunk on the calling thread. Chunk c covers [count * c / chunks, count * (c + 1) / chunks),
+  so results collected per chunk can be merged in order to get the same result as a serial loop.
+*/
+typedef void (*parallel_fn_t)(unsigned int chunk, size_t begin, size_t end, void* ctx);
+
+unsigned int parallel_chunks(size_t count, size_t grain);
+void parallel_run(unsigned int chunks, size_t count, parallel_fn_t fn, void* ctx);
+void parallel_set_threads(unsigned int threads);
+
+/*
+  Runs fn once for every task in [0, count) on a work-stealing pool, for tasks whose costs vary
+  too much to split up front. Every worker starts with an equal share of the tasks and, once it
+  runs out, steals half of what is left from another worker. worker is below
+  parallel_workers(count), so results can be collected per worker without locking.
+*/
+typedef void (*parallel_task_t)(unsigned int worker, size_t task, void* ctx);
+
+unsigned int parallel_workers(size_t count);
+void parallel_steal(size_t count, parallel_task_t fn, void* ctx);
+
+#endif
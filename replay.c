@@ -0,0 +1,324 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+#include "snake_utils.h"
+
+// Size of a block up to its snake table
+#define BLOCK_HEADER_SIZE 24
+// tail_x, tail_y, head_x, head_y, live
+#define SNAKE_RECORD_SIZE 17
+
+// Directions in clockwise order, so turning right adds one
+static const char* heads = "^>v<";
+static const char* tails = "wdsa";
+
+static int direction(char c) {
+  const char* head = strchr(heads, c);
+  if (head != NULL && c != '\0') {
+    return head - heads;
+  }
+  const char* tail = strchr(tails, c);
+  return tail != NULL && c != '\0' ? tail - tails : -1;
+}
+
+static void put_u32(uint8_t* buf, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    buf[i] = value >> (8 * i);
+  }
+}
+
+static uint32_t get_u32(const uint8_t* buf) {
+  return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static void put_u64(uint8_t* buf, uint64_t value) {
+  put_u32(buf, value);
+  put_u32(buf + 4, value >> 32);
+}
+
+static uint64_t get_u64(const uint8_t* buf) {
+  return get_u32(buf) | (uint64_t) get_u32(buf + 4) << 32;
+}
+
+static void push_bits(replay_writer_t* writer, unsigned int value, unsigned int bits) {
+  if (writer->num_turn_bits + bits > writer->turn_capacity * 8) {
+    writer->turn_capacity = writer->turn_capacity * 2 + 64;
+    writer->turns = realloc(writer->turns, writer->turn_capacity);
+  }
+  for (unsigned int i = 0; i < bits; i++) {
+    size_t bit = writer->num_turn_bits + i;
+    if (bit % 8 == 0) {
+      writer->turns[bit / 8] = 0;
+    }
+    writer->turns[bit / 8] |= ((value >> i) & 1) << (bit % 8);
+  }
+  writer->num_turn_bits += bits;
+}
+
+/* Reads the next bits from turns, which holds num_bits. Reads past the end give zeros. */
+static unsigned int pop_bits(const uint8_t* turns, size_t num_bits, size_t* bit, unsigned int bits) {
+  unsigned int value = 0;
+  for (unsigned int i = 0; i < bits && *bit + i < num_bits; i++) {
+    value |= ((turns[(*bit + i) / 8] >> ((*bit + i) % 8)) & 1) << i;
+  }
+  *bit += bits;
+  return value;
+}
+
+static void write_all(replay_writer_t* writer, const void* buf, size_t size) {
+  if (writer->error == 0 && size > 0 && fwrite(buf, 1, size, writer->file) != size) {
+    writer->error = errno != 0 ? errno : EIO;
+  }
+}
+
+/* Writes out the block recorded so far, with its tick count and turns filled in. */
+static void flush_block(replay_writer_t* writer) {
+  if (writer->block_ticks == 0) {
+    return;
+  }
+  size_t turn_bytes = (writer->num_turn_bits + 7) / 8;
+  put_u32(writer->block + 8, writer->block_ticks);
+  put_u32(writer->block + 20, turn_bytes);
+  write_all(writer, writer->block, writer->block_size);
+  write_all(writer, writer->turns, turn_bytes);
+  writer->block_ticks = 0;
+  writer->num_turn_bits = 0;
+}
+
+/* Starts a new block with a keyframe of state, as it was before this tick's turns. */
+static void start_block(replay_writer_t* writer, game_state_t* state) {
+  uint8_t* buf = writer->block;
+  put_u64(buf, writer->ticks);
+  put_u32(buf + 12, seed);
+  put_u32(buf + 16, snake_seed);
+  buf += BLOCK_HEADER_SIZE;
+  for (unsigned int i = 0; i < writer->num_snakes; i++) {
+    snake_t* snake = &state->snakes[i];
+    put_u32(buf, snake->tail_x);
+    put_u32(buf + 4, snake->tail_y);
+    put_u32(buf + 8, snake->head_x);
+    put_u32(buf + 12, snake->head_y);
+    buf[16] = snake->live;
+    buf += SNAKE_RECORD_SIZE;
+  }
+  for (unsigned int y = 0; y < writer->y_size; y++) {
+    memcpy(buf + y * (writer->x_size + 1), state->board[y], writer->x_size);
+    buf[y * (writer->x_size + 1) + writer->x_size] = '\n';
+  }
+  for (unsigned int i = 0; i < writer->num_snakes; i++) {
+    snake_t* snake = &state->snakes[i];
+    if (snake->live) {
+      buf[snake->head_y * (writer->x_size + 1) + snake->head_x] = heads[writer->last_dirs[i]];
+    }
+  }
+}
+
+/*
+  Starts recording the game in state to filename, with a keyframe every keyframe_every ticks.
+  Returns NULL if the file can't be created.
+*/
+replay_writer_t* replay_writer_create(const char* filename, game_state_t* state, unsigned int keyframe_every) {
+  FILE* file = fopen(filename, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return NULL;
+  }
+  replay_writer_t* writer = calloc(1, sizeof(replay_writer_t));
+  writer->file = file;
+  writer->keyframe_every = keyframe_every == 0 ? 1 : keyframe_every;
+  writer->x_size = state->x_size;
+  writer->y_size = state->y_size;
+  writer->num_snakes = state->num_snakes;
+  writer->last_dirs = malloc(state->num_snakes + 1);
+  for (unsigned int i = 0; i < state->num_snakes; i++) {
+    int dir = direction(get_board_at(state, state->snakes[i].head_x, state->snakes[i].head_y));
+    writer->last_dirs[i] = dir < 0 ? 0 : dir;
+  }
+  writer->block_size =
+    BLOCK_HEADER_SIZE + (size_t) state->num_snakes * SNAKE_RECORD_SIZE + (size_t) (state->x_size + 1) * state->y_size;
+  // The turns of one tick are worked out in the spare room after the block
+  writer->block = malloc(writer->block_size + state->num_snakes);
+
+  uint8_t header[24];
+  put_u32(header, REPLAY_MAGIC);
+  put_u32(header + 4, REPLAY_VERSION);
+  put_u32(header + 8, writer->keyframe_every);
+  put_u32(header + 12, writer->x_size);
+  put_u32(header + 16, writer->y_size);
+  put_u32(header + 20, writer->num_snakes);
+  write_all(writer, header, sizeof(header));
+  return writer;
+}
+
+/*
+  Records the turns of one tick. Call it once per tick, after the snakes have been steered and
+  right before update_state.
+*/
+void replay_record_tick(replay_writer_t* writer, game_state_t* state) {
+  if (writer->ticks % writer->keyframe_every == 0) {
+    flush_block(writer);
+    start_block(writer, state);
+  }
+
+  // Each live snake faced the way it last moved until it was steered
+  uint8_t* codes = writer->block + writer->block_size;
+  bool turned = false;
+  for (unsigned int j = 0; j < state->num_live; j++) {
+    unsigned int i = state->live_snakes[j];
+    snake_t* snake = &state->snakes[i];
+    int facing = direction(get_board_at(state, snake->head_x, snake->head_y));
+    codes[i] = facing < 0 ? 0 : (facing - writer->last_dirs[i] + 4) % 4;
+    writer->last_dirs[i] = (writer->last_dirs[i] + codes[i]) % 4;
+    turned = turned || codes[i] != 0;
+  }
+  push_bits(writer, turned, 1);
+  for (unsigned int j = 0; j < state->num_live && turned; j++) {
+    push_bits(writer, codes[state->live_snakes[j]], 2);
+  }
+  writer->block_ticks += 1;
+  writer->ticks += 1;
+}
+
+/* Writes out the last block and closes the file. Returns 0, or the errno of the first write that failed. */
+int replay_writer_close(replay_writer_t* writer) {
+  flush_block(writer);
+  if (fclose(writer->file) != 0 && writer->error == 0) {
+    writer->error = errno;
+  }
+  int error = writer->error;
+  free(writer->last_dirs);
+  free(writer->block);
+  free(writer->turns);
+  free(writer);
+  return error;
+}
+
+/* Opens a recording and indexes its keyframes. Returns NULL if it can't be read. */
+replay_t* replay_open(const char* filename) {
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return NULL;
+  }
+  uint8_t header[24];
+  if (fread(header, 1, sizeof(header), file) != sizeof(header) || get_u32(header) != REPLAY_MAGIC
+      || get_u32(header + 4) != REPLAY_VERSION || get_u32(header + 8) == 0) {
+    fprintf(stderr, "%s: not a replay\n", filename);
+    fclose(file);
+    return NULL;
+  }
+  replay_t* replay = calloc(1, sizeof(replay_t));
+  replay->file = file;
+  replay->keyframe_every = get_u32(header + 8);
+  replay->x_size = get_u32(header + 12);
+  replay->y_size = get_u32(header + 16);
+  replay->num_snakes = get_u32(header + 20);
+  size_t keyframe_size =
+    (size_t) replay->num_snakes * SNAKE_RECORD_SIZE + (size_t) (replay->x_size + 1) * replay->y_size;
+
+  size_t capacity = 0;
+  uint8_t block[BLOCK_HEADER_SIZE];
+  long offset = sizeof(header);
+  while (fread(block, 1, sizeof(block), file) == sizeof(block)) {
+    if (replay->num_blocks == capacity) {
+      capacity = capacity * 2 + 16;
+      replay->blocks = realloc(replay->blocks, capacity * sizeof(replay_block_t));
+    }
+    replay_block_t* entry = &replay->blocks[replay->num_blocks];
+    entry->tick = get_u64(block);
+    entry->ticks = get_u32(block + 8);
+    entry->offset = offset;
+    if (entry->tick != replay->ticks || entry->ticks == 0) {
+      break;
+    }
+    offset += BLOCK_HEADER_SIZE + keyframe_size + get_u32(block + 20);
+    if (fseek(file, offset, SEEK_SET) != 0) {
+      break;
+    }
+    replay->num_blocks += 1;
+    replay->ticks += entry->ticks;
+  }
+  return replay;
+}
+
+/*
+  Returns the game as it was after tick ticks, the same board snake -n tick would have ended on,
+  and sets the random seeds to what they were then, so the game can go on from there. snake_seed
+  is only restored exactly at keyframes. Returns NULL if the recording doesn't reach tick.
+*/
+game_state_t* replay_seek(replay_t* replay, unsigned long tick) {
+  if (tick > replay->ticks || replay->num_blocks == 0) {
+    return NULL;
+  }
+  // Blocks start every keyframe_every ticks; the end of the game is in the last one
+  size_t b = tick / replay->keyframe_every;
+  if (b >= replay->num_blocks) {
+    b = replay->num_blocks - 1;
+  }
+  if (replay->blocks[b].tick > tick || replay->blocks[b].tick + replay->blocks[b].ticks < tick) {
+    return NULL;
+  }
+  replay_block_t* entry = &replay->blocks[b];
+
+  uint8_t header[BLOCK_HEADER_SIZE];
+  fseek(replay->file, entry->offset, SEEK_SET);
+  if (fread(header, 1, sizeof(header), replay->file) != sizeof(header)) {
+    return NULL;
+  }
+  size_t snakes_size = (size_t) replay->num_snakes * SNAKE_RECORD_SIZE;
+  size_t board_size = (size_t) (replay->x_size + 1) * replay->y_size;
+  size_t turn_bytes = get_u32(header + 20);
+  uint8_t* buf = malloc(snakes_size + board_size + turn_bytes + 1);
+  if (fread(buf, 1, snakes_size + board_size + turn_bytes, replay->file) != snakes_size + board_size + turn_bytes) {
+    free(buf);
+    return NULL;
+  }
+
+  game_state_t* state = load_board_from_memory("replay keyframe", (char*) buf + snakes_size, board_size);
+  if (state == NULL) {
+    free(buf);
+    return NULL;
+  }
+  free(state->tail_hints);
+  state->tail_hints = NULL;
+  state->num_tail_hints = 0;
+  state->num_snakes = replay->num_snakes;
+  state->snakes = malloc((replay->num_snakes + 1) * sizeof(snake_t));
+  for (unsigned int i = 0; i < replay->num_snakes; i++) {
+    uint8_t* record = buf + i * SNAKE_RECORD_SIZE;
+    state->snakes[i].tail_x = get_u32(record);
+    state->snakes[i].tail_y = get_u32(record + 4);
+    state->snakes[i].head_x = get_u32(record + 8);
+    state->snakes[i].head_y = get_u32(record + 12);
+    state->snakes[i].live = record[16];
+  }
+  refresh_live_snakes(state);
+  seed = get_u32(header + 12);
+  snake_seed = get_u32(header + 16);
+
+  // Play forward from the keyframe, turning the snakes the way they turned in the game
+  const uint8_t* turns = buf + snakes_size + board_size;
+  size_t num_bits = turn_bytes * 8;
+  size_t bit = 0;
+  for (unsigned long t = entry->tick; t < tick; t++) {
+    if (pop_bits(turns, num_bits, &bit, 1)) {
+      for (unsigned int j = 0; j < state->num_live; j++) {
+        snake_t* snake = &state->snakes[state->live_snakes[j]];
+        int facing = direction(get_board_at(state, snake->head_x, snake->head_y));
+        if (facing >= 0) {
+          set_board_at(state, snake->head_x, snake->head_y, heads[(facing + pop_bits(turns, num_bits, &bit, 2)) % 4]);
+        }
+      }
+    }
+    update_state(state, deterministic_food);
+  }
+  free(buf);
+  return state;
+}
+
+void replay_close(replay_t* replay) {
+  fclose(replay->file);
+  free(replay->blocks);
+  free(replay);
+}
@@ -0,0 +1,82 @@
+#ifndef _SNK_REPLAY_H
+#define _SNK_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "state.h"
+
+#define REPLAY_MAGIC 0x524b4e53
+#define REPLAY_VERSION 1
+#define REPLAY_KEYFRAME_TICKS 1000
+
+/*
+  Records a game as the turns its snakes took instead of the boards it went through. Food comes
+  from deterministic_food, so the board, the snake table and the random seeds at some tick are
+  enough to play the game forward from there, given the turns.
+
+  Every tick is stored as one bit saying whether any snake turned, followed (if one did) by two
+  bits for each live snake: straight on, right, back or left, relative to the way it last moved.
+  Every keyframe_every ticks the file holds a keyframe with the full board (as it was before that
+  tick's turns), snake table and seeds, so seeking never plays more than keyframe_every ticks.
+
+  The file is a header followed by blocks of one keyframe and the turns of the ticks after it:
+
+    header:  magic, version, keyframe_every, x_size, y_size, num_snakes (u32 each)
+    block:   tick (u64), ticks, seed, snake_seed, turn_bytes (u32 each),
+             num_snakes * (tail_x, tail_y, head_x, head_y (u32 each), live (u8)),
+             y_size rows of x_size cells and a newline, turn_bytes of turns
+
+  All integers are little-endian.
+*/
+typedef struct replay_writer_t {
+  FILE* file;
+  unsigned int keyframe_every;
+  unsigned int x_size;
+  unsigned int y_size;
+  unsigned int num_snakes;
+  unsigned long ticks;
+
+  // Direction each snake last moved in, which is where it faces until it is steered
+  uint8_t* last_dirs;
+
+  // The block being recorded, written out once the next keyframe is due
+  uint8_t* block;
+  size_t block_size;
+  size_t block_capacity;
+  unsigned int block_ticks;
+  // Turns recorded since the keyframe, packed low bit first
+  uint8_t* turns;
+  size_t num_turn_bits;
+  size_t turn_capacity;
+
+  // errno of the first failed write, or 0
+  int error;
+} replay_writer_t;
+
+typedef struct replay_block_t {
+  unsigned long tick;
+  unsigned int ticks;
+  long offset;
+} replay_block_t;
+
+typedef struct replay_t {
+  FILE* file;
+  unsigned int keyframe_every;
+  unsigned int x_size;
+  unsigned int y_size;
+  unsigned int num_snakes;
+  unsigned long ticks;
+  replay_block_t* blocks;
+  size_t num_blocks;
+} replay_t;
+
+replay_writer_t* replay_writer_create(const char* filename, game_state_t* state, unsigned int keyframe_every);
+void replay_record_tick(replay_writer_t* writer, game_state_t* state);
+int replay_writer_close(replay_writer_t* writer);
+
+replay_t* replay_open(const char* filename);
+game_state_t* replay_seek(replay_t* replay, unsigned long tick);
+void replay_close(replay_t* replay);
+
+#endif
@@ -0,0 +1,91 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "replay.h"
+#include "snake_utils.h"
+#include "state.h"
+
+/*
+  Replay tool: prints the board of a recorded game at any tick, by loading the keyframe before it
+  and playing the recorded turns forward.
+*/
+
+int main(int argc, char* argv[]) {
+  char* replay_filename = NULL;
+  char* out_filename = NULL;
+  unsigned long tick = 0;
+  bool last_tick = true;
+  bool print_info = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+      replay_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+      tick = strtoul(argv[i + 1], NULL, 10);
+      last_tick = false;
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-o") == 0 && i < argc - 1) {
+      out_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--info") == 0) {
+      print_info = true;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s -r replay filename [-t tick] [-o filename] [--info]\n", argv[0]);
+    return 1;
+  }
+  if (replay_filename == NULL) {
+    fprintf(stderr, "Usage: %s -r replay filename [-t tick] [-o filename] [--info]\n", argv[0]);
+    return 1;
+  }
+
+  replay_t* replay = replay_open(replay_filename);
+  if (replay == NULL) {
+    return 1;
+  }
+  if (last_tick) {
+    tick = replay->ticks;
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  game_state_t* state = replay_seek(replay, tick);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (state == NULL) {
+    fprintf(stderr, "%s: can't seek to tick %lu (%lu ticks recorded)\n", replay_filename, tick, replay->ticks);
+    replay_close(replay);
+    return 1;
+  }
+
+  if (print_info) {
+    struct stat st;
+    long size = stat(replay_filename, &st) == 0 ? (long) st.st_size : -1;
+    fprintf(stderr, "%lu ticks, %ux%u board, %u snakes, keyframe every %u ticks (%zu keyframes)\n", replay->ticks,
+            replay->x_size, replay->y_size, replay->num_snakes, replay->keyframe_every, replay->num_blocks);
+    fprintf(stderr, "%ld bytes, %.2f bytes per tick\n", size, replay->ticks == 0 ? 0.0 : (double) size / replay->ticks);
+    fprintf(stderr, "seeked to tick %lu in %.3f ms\n", tick,
+            (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+  }
+
+  if (out_filename != NULL) {
+    save_board(state, out_filename);
+  } else {
+    print_board(state, stdout);
+  }
+  free_state(state);
+  replay_close(replay);
+  return 0;
+}
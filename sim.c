@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <string.h>
+#include "fixed_engine.h"
+#include "sim.h"
+#include "snake_utils.h"
+
+static uint64_t mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*
+  Hash of everything that decides how the game continues: the board, the snake table and the random
+  seeds. Two ticks with the same fingerprint almost certainly have the same future.
+*/
+uint64_t state_fingerprint(game_state_t* state) {
+  uint64_t hash = state->hash ^ mix(seed) ^ mix((uint64_t) snake_seed << 32);
+  for (unsigned int i = 0; i < state->num_snakes; i++) {
+    snake_t* snake = &state->snakes[i];
+    uint64_t pos = (uint64_t) snake->head_x << 48 ^ (uint64_t) snake->head_y << 32 ^ (uint64_t) snake->tail_x << 16
+                   ^ snake->tail_y ^ (uint64_t) snake->live << 63;
+    hash ^= mix(pos + i);
+  }
+  return hash;
+}
+
+/* Full comparison, used to rule out fingerprint collisions. Rows still shared by a clone compare instantly. */
+static bool states_equal(game_state_t* a, uint32_t a_seed, uint32_t a_snake_seed, game_state_t* b) {
+  if (a_seed != seed || a_snake_seed != snake_seed || a->num_snakes != b->num_snakes) {
+    return false;
+  }
+  if (memcmp(a->snakes, b->snakes, a->num_snakes * sizeof(snake_t)) != 0) {
+    return false;
+  }
+  if (a->sparse != NULL) {
+    return sparse_board_equal(a->sparse, b->sparse);
+  }
+  for (unsigned int y = 0; y < a->y_size; y++) {
+    if (a->board[y] != b->board[y] && memcmp(a->board[y], b->board[y], a->x_size) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Runs update_state (or its fixed-size variant) up to ticks times, calling steer (if it is not
+  NULL) before each tick. Once no snake is alive the board can no longer change, so the run stops
+  early. With detect_cycles, Brent's algorithm watches for the game returning to an earlier state;
+  when it does, every remaining full cycle is skipped and only the leftover ticks are simulated.
+  Either way, state ends up exactly as if all ticks had been run.
+
+  Food must come from an add_food function that only depends on the board and the food seed, such
+  as deterministic_food or corner_food.
+*/
+bool simulate(game_state_t* state, int (*add_food)(game_state_t* state), sim_steer_t steer, void* steer_ctx,
+              unsigned long ticks, bool detect_cycles, sim_result_t* result) {
+  memset(result, 0, sizeof(sim_result_t));
+
+  // Brent's algorithm: keep a copy of the state at tick 2^k - 1 and compare each later tick to it
+  game_state_t* saved = NULL;
+  uint64_t saved_fingerprint = 0;
+  uint32_t saved_seed = 0;
+  uint32_t saved_snake_seed = 0;
+  unsigned long power = 1;
+  unsigned long lam = 0;
+
+  // The board's shape never changes, so the engine is picked once
+  update_fn_t update = fixed_engine_for(state);
+  unsigned long tick = 0;
+  while (tick < ticks) {
+    if (state->num_live == 0) {
+      result->all_dead = true;
+      result->ticks_skipped = ticks - tick;
+      break;
+    }
+
+    if (detect_cycles && result->cycle_length == 0) {
+      uint64_t fingerprint = state_fingerprint(state);
+      if (saved != NULL && fingerprint == saved_fingerprint && states_equal(saved, saved_seed, saved_snake_seed, state)) {
+        result->cycle_length = lam;
+        unsigned long skip = (ticks - tick) / lam * lam;
+        result->ticks_skipped = skip;
+        tick += skip;
+        continue;
+      }
+      if (saved == NULL || lam == power) {
+        if (saved != NULL) {
+          free_state(saved);
+          power *= 2;
+        }
+        saved = clone_state(state);
+        saved_fingerprint = fingerprint;
+        saved_seed = seed;
+        saved_snake_seed = snake_seed;
+        lam = 0;
+      }
+    }
+
+    if (steer != NULL) {
+      steer(state, steer_ctx);
+    }
+    update(state, add_food);
+    result->ticks_run += 1;
+    lam += 1;
+    tick += 1;
+  }
+
+  if (saved != NULL) {
+    free_state(saved);
+  }
+  return result->all_dead || result->cycle_length != 0;
+}
@@ -0,0 +1,28 @@
+#ifndef _SNK_SIM_H
+#define _SNK_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "state.h"
+
+typedef struct sim_result_t {
+  // Ticks actually passed to update_state
+  unsigned long ticks_run;
+  // Ticks skipped because the game was found to repeat or to have no live snakes
+  unsigned long ticks_skipped;
+  // Length of the repeating cycle that was found, or 0
+  unsigned long cycle_length;
+  bool all_dead;
+} sim_result_t;
+
+/*
+  Called before every tick to turn snakes (or just to watch the game). Any turns it makes must only
+  depend on the board and the random seeds.
+*/
+typedef void (*sim_steer_t)(game_state_t* state, void* ctx);
+
+uint64_t state_fingerprint(game_state_t* state);
+bool simulate(game_state_t* state, int (*add_food)(game_state_t* state), sim_steer_t steer, void* steer_ctx,
+              unsigned long ticks, bool detect_cycles, sim_result_t* result);
+
+#endif
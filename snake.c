@@ -1,13 +1,71 @@
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "autopilot.h"
+#include "checkpoint.h"
+#include "frame_ring.h"
+#include "replay.h"
+#include "sim.h"
 #include "snake_utils.h"
 #include "state.h"
+#include "stats.h"
+
+typedef struct tick_hooks_t
+{
+  // Any of these may be NULL
+  autopilot_t *autopilot;
+  checkpoint_t *checkpoint;
+  unsigned long checkpoint_every;
+  frame_ring_t *ring;
+  replay_writer_t *replay;
+  unsigned long tick;
+} tick_hooks_t;
+
+/*
+  Runs before every simulated tick: steers the snakes, records their turns, publishes the frame
+  and queues a checkpoint every so often.
+*/
+static void run_tick_hooks(game_state_t *state, void *ctx)
+{
+  tick_hooks_t *hooks = (tick_hooks_t *)ctx;
+  if (hooks->autopilot != NULL)
+  {
+    autopilot_steer_all(state, hooks->autopilot);
+  }
+  if (hooks->replay != NULL)
+  {
+    replay_record_tick(hooks->replay, state);
+  }
+  if (hooks->ring != NULL)
+  {
+    frame_ring_publish(hooks->ring, state, hooks->tick);
+  }
+  if (hooks->checkpoint != NULL && hooks->tick > 0 && hooks->tick % hooks->checkpoint_every == 0)
+  {
+    checkpoint_save(hooks->checkpoint, state);
+  }
+  hooks->tick += 1;
+}
 
 int main(int argc, char *argv[])
 {
   char *in_filename = NULL;
   char *out_filename = NULL;
   game_state_t *state = NULL;
+  bool print_hash = false;
+  unsigned long ticks = 1;
+  bool detect_cycles = true;
+  bool print_stats = false;
+  bool map_input = false;
+  bool sparse_input = false;
+  char *checkpoint_filename = NULL;
+  char *ring_name = NULL;
+  char *replay_filename = NULL;
+  unsigned int keyframe_every = REPLAY_KEYFRAME_TICKS;
+  bool use_autopilot = false;
+  unsigned long checkpoint_every = 100000;
 
   // Parse arguments
   for (int i = 1; i < argc; i++)
@@ -24,7 +82,84 @@ int main(int argc, char *argv[])
       i++;
       continue;
     }
-    fprintf(stderr, "Usage: %s [-i filename] [-o filename]\n", argv[0]);
+    if (strcmp(argv[i], "-n") == 0 && i < argc - 1)
+    {
+      ticks = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-c") == 0 && i < argc - 1)
+    {
+      checkpoint_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-k") == 0 && i < argc - 1)
+    {
+      checkpoint_every = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-p") == 0 && i < argc - 1)
+    {
+      ring_name = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-r") == 0 && i < argc - 1)
+    {
+      replay_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-K") == 0 && i < argc - 1)
+    {
+      keyframe_every = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--hash") == 0)
+    {
+      print_hash = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--no-skip") == 0)
+    {
+      detect_cycles = false;
+      continue;
+    }
+    if (strcmp(argv[i], "--stats") == 0)
+    {
+      print_stats = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--mmap") == 0)
+    {
+      map_input = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--autopilot") == 0)
+    {
+      use_autopilot = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--sparse") == 0)
+    {
+      sparse_input = true;
+      continue;
+    }
+    fprintf(stderr,
+            "Usage: %s [-i filename] [-o filename] [-n ticks] [-c checkpoint filename] [-k checkpoint ticks] "
+            "[-p frame ring name] [-r replay filename] [-K keyframe ticks] [--hash] [--no-skip] [--stats] [--mmap] "
+            "[--autopilot] [--sparse]\n",
+            argv[0]);
+    return 1;
+  }
+
+  // Sparse boards have no rows for these to read
+  if (sparse_input && (map_input || use_autopilot || checkpoint_filename != NULL || ring_name != NULL || replay_filename != NULL))
+  {
+    fprintf(stderr, "--sparse can't be combined with --mmap, --autopilot, -c, -p or -r\n");
     return 1;
   }
 
@@ -36,7 +171,19 @@ int main(int argc, char *argv[])
   if (in_filename != NULL)
   {
     // TODO: load the board from in_filename into state...
-    state = load_board(in_filename);
+    if (sparse_input)
+    {
+      state = load_board_sparse(in_filename);
+    }
+    else
+    {
+      state = map_input ? load_board_mapped(in_filename) : load_board(in_filename);
+    }
+    // load_board has already reported why the board couldn't be loaded
+    if (state == NULL)
+    {
+      return 1;
+    }
     // TODO: ...then call initialize_snakes on the state you made
     initialize_snakes(state);
   }
@@ -47,7 +194,70 @@ int main(int argc, char *argv[])
   }
   // TODO: Update state. Use the deterministic_food function
   // (already implemented in state_utils.h) to add food.
-  update_state(state, deterministic_food);
+  // Long runs stop once every snake is dead, and skip ahead once the game starts repeating itself.
+  // Checkpoints are written in the background while the game keeps running, and every frame can be
+  // published for spectators or recorded as a replay
+  tick_hooks_t hooks;
+  hooks.autopilot = use_autopilot ? autopilot_create(state) : NULL;
+  hooks.checkpoint = NULL;
+  hooks.checkpoint_every = checkpoint_every;
+  hooks.ring = NULL;
+  hooks.replay = NULL;
+  hooks.tick = 0;
+  if (checkpoint_filename != NULL && checkpoint_every > 0)
+  {
+    hooks.checkpoint = checkpoint_create(checkpoint_filename);
+    // Checkpoints fall every checkpoint_every ticks the hook sees, so none can be skipped
+    detect_cycles = false;
+  }
+  if (ring_name != NULL)
+  {
+    hooks.ring = frame_ring_create(ring_name, state->x_size, state->y_size, FRAME_RING_SLOTS);
+    if (hooks.ring == NULL)
+    {
+      return 1;
+    }
+    // Frames are numbered by the ticks the hook sees, so none can be skipped
+    detect_cycles = false;
+  }
+  if (replay_filename != NULL)
+  {
+    hooks.replay = replay_writer_create(replay_filename, state, keyframe_every);
+    if (hooks.replay == NULL)
+    {
+      return 1;
+    }
+    // A replay has to hold every tick, so none can be skipped
+    detect_cycles = false;
+  }
+  bool any_hooks = hooks.autopilot != NULL || hooks.checkpoint != NULL || hooks.ring != NULL || hooks.replay != NULL;
+  sim_result_t result;
+  simulate(state, deterministic_food, any_hooks ? run_tick_hooks : NULL, &hooks, ticks, detect_cycles, &result);
+  if (hooks.ring != NULL)
+  {
+    frame_ring_publish(hooks.ring, state, hooks.tick);
+    frame_ring_destroy(hooks.ring);
+  }
+  if (hooks.autopilot != NULL)
+  {
+    autopilot_destroy(hooks.autopilot);
+  }
+  if (hooks.replay != NULL)
+  {
+    int error = replay_writer_close(hooks.replay);
+    if (error != 0)
+    {
+      fprintf(stderr, "Error writing replay %s: %s\n", replay_filename, strerror(error));
+    }
+  }
+  if (hooks.checkpoint != NULL)
+  {
+    int error = checkpoint_destroy(hooks.checkpoint);
+    if (error != 0)
+    {
+      fprintf(stderr, "Error writing checkpoint %s: %s\n", checkpoint_filename, strerror(error));
+    }
+  }
   // Write updated board to file, or print to stdout if no output filename was given
   if (out_filename != NULL)
   {
@@ -57,13 +267,21 @@ int main(int argc, char *argv[])
   else
   {
     // TODO: print the board to stdout
-    for (int i = 0; i < state->y_size; i += 1)
-    {
-      printf("%s", state->board[i]);
-    }
+    print_board(state, stdout);
+  }
+
+  // Print the board hash so runs can be compared without diffing whole boards
+  if (print_hash)
+  {
+    fprintf(out_filename != NULL ? stdout : stderr, "%016" PRIx64 "\n", state->hash);
   }
 
   // TODO: free any allocated memory
   free_state(state);
+
+  if (print_stats)
+  {
+    stats_dump_json(stderr);
+  }
   return 0;
 }
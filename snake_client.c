@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "daemon.h"
+
+/*
+  Client for snaked: sends a board and a tick count and prints the board that comes back, like
+  ./snake -i filename -n ticks would. With -R the same request is sent over and over on one
+  connection, and the request rate is reported.
+*/
+
+/* Reads all of filename, or stdin if it is "-". */
+static char* read_all(const char* filename, size_t* len) {
+  FILE* f = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return NULL;
+  }
+  size_t capacity = 65536;
+  char* buf = malloc(capacity);
+  *len = 0;
+  size_t n;
+  while ((n = fread(buf + *len, 1, capacity - *len, f)) > 0) {
+    *len += n;
+    if (*len == capacity) {
+      capacity *= 2;
+      buf = realloc(buf, capacity);
+    }
+  }
+  if (f != stdin) {
+    fclose(f);
+  }
+  return buf;
+}
+
+static bool send_all(int fd, const void* data, size_t len) {
+  const char* bytes = data;
+  while (len > 0) {
+    ssize_t n = send(fd, bytes, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    len -= n;
+  }
+  return true;
+}
+
+/*
+  Sends one request and reads its response into *response. Returns false (after reporting why) if
+  the request failed.
+*/
+static bool request(int fd, FILE* in, bool binary, uint64_t ticks, const char* board, size_t len, char** response,
+                    size_t* response_len, uint64_t* hash) {
+  bool sent;
+  if (binary) {
+    uint8_t header[DAEMON_REQUEST_HEADER_SIZE];
+    daemon_put_request(header, ticks, len);
+    sent = send_all(fd, header, sizeof(header));
+  } else {
+    char header[64];
+    int size = snprintf(header, sizeof(header), "%" PRIu64 " %zu\n", ticks, len);
+    sent = send_all(fd, header, size);
+  }
+  if (!sent || !send_all(fd, board, len)) {
+    fprintf(stderr, "snaked: %s\n", strerror(errno));
+    return false;
+  }
+
+  uint32_t status = 0;
+  uint32_t length = 0;
+  if (binary) {
+    uint8_t header[DAEMON_RESPONSE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) || !daemon_get_response(header, &status, hash, &length)) {
+      fprintf(stderr, "snaked: bad response\n");
+      return false;
+    }
+  } else {
+    char line[512];
+    if (fgets(line, sizeof(line), in) == NULL) {
+      fprintf(stderr, "snaked: bad response\n");
+      return false;
+    }
+    if (strncmp(line, "error ", 6) == 0) {
+      fprintf(stderr, "snaked: %s", line + 6);
+      return false;
+    }
+    if (sscanf(line, "ok %" SCNx64 " %" SCNu32, hash, &length) != 2) {
+      fprintf(stderr, "snaked: bad response\n");
+      return false;
+    }
+  }
+  *response = realloc(*response, length + 1);
+  if (fread(*response, 1, length, in) != length) {
+    fprintf(stderr, "snaked: bad response\n");
+    return false;
+  }
+  (*response)[length] = '\0';
+  *response_len = length;
+  if (status != 0) {
+    fprintf(stderr, "snaked: %s\n", *response);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  char* socket_path = DAEMON_SOCKET;
+  char* in_filename = NULL;
+  uint64_t ticks = 1;
+  unsigned long repeat = 1;
+  bool binary = false;
+  bool print_hash = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-S") == 0 && i < argc - 1) {
+      socket_path = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-i") == 0 && i < argc - 1) {
+      in_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-n") == 0 && i < argc - 1) {
+      ticks = strtoull(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-R") == 0 && i < argc - 1) {
+      repeat = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--binary") == 0) {
+      binary = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--hash") == 0) {
+      print_hash = true;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s -i filename [-S socket path] [-n ticks] [-R requests] [--binary] [--hash]\n", argv[0]);
+    return 1;
+  }
+  if (in_filename == NULL || repeat == 0) {
+    fprintf(stderr, "Usage: %s -i filename [-S socket path] [-n ticks] [-R requests] [--binary] [--hash]\n", argv[0]);
+    return 1;
+  }
+
+  size_t len;
+  char* board = read_all(in_filename, &len);
+  if (board == NULL) {
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "%s: %s\n", socket_path, strerror(errno));
+    return 1;
+  }
+  FILE* in = fdopen(fd, "r");
+
+  char* response = NULL;
+  size_t response_len = 0;
+  uint64_t hash = 0;
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned long i = 0; i < repeat; i++) {
+    if (!request(fd, in, binary, ticks, board, len, &response, &response_len, &hash)) {
+      return 1;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  fwrite(response, 1, response_len, stdout);
+  if (print_hash) {
+    fprintf(stderr, "%016" PRIx64 "\n", hash);
+  }
+  if (repeat > 1) {
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%lu requests in %.3f s: %.0f requests per second, %.1f us each\n", repeat, seconds,
+            repeat / seconds, seconds * 1e6 / repeat);
+  }
+  fclose(in);
+  free(response);
+  free(board);
+  return 0;
+}
@@ -1,7 +1,11 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include "snake_utils.h"
 #include "state.h"
+#include "stats.h"
+
+#define FOOD_MAX_RETRIES 64
 
 uint32_t det_rand(uint32_t* state) {
   if (*state == 0) {
@@ -18,19 +22,42 @@ uint32_t det_rand(uint32_t* state) {
 uint32_t seed = 1;
 
 int deterministic_food(game_state_t* state) {
-  unsigned int x = det_rand(&seed) % state->x_size;
-  unsigned int y = det_rand(&seed) % state->y_size;
-  while (state->board[y][x] != ' ') {
-    x = det_rand(&seed) % state->x_size;
-    y = det_rand(&seed) % state->y_size;
+  return seeded_food(state, &seed);
+}
+
+/* Whether any cell of the board is empty. */
+static bool has_free_cell(game_state_t* state) {
+  for (unsigned int y = 0; y < state->y_size; y++) {
+    for (unsigned int x = 0; x < state->x_size; x++) {
+      if (get_board_at(state, x, y) == ' ') {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int seeded_food(game_state_t* state, uint32_t* food_seed) {
+  unsigned int x = det_rand(food_seed) % state->x_size;
+  unsigned int y = det_rand(food_seed) % state->y_size;
+  unsigned long retries = 0;
+  while (get_board_at(state, x, y) != ' ') {
+    // A full board would never hit, so after enough misses make sure there is somewhere to hit
+    retries += 1;
+    if (retries == FOOD_MAX_RETRIES && !has_free_cell(state)) {
+      return 0;
+    }
+    x = det_rand(food_seed) % state->x_size;
+    y = det_rand(food_seed) % state->y_size;
+    STATS_COUNT(STATS_FOOD_RETRIES, 1);
   }
-  state->board[y][x] = '*';
+  set_board_at(state, x, y, '*');
 
   return 1;
 }
 
 int corner_food(game_state_t* state) {
-  state->board[1][1] = '*';
+  set_board_at(state, 1, 1, '*');
   return 1;
 }
 
@@ -45,32 +72,36 @@ void redirect_snake(game_state_t* state, char newhead) {
   }
 
   if (newhead == 'w') {
-    state->board[y][x] = '^';
+    set_board_at(state, x, y, '^');
   } else if (newhead == 'a') {
-    state->board[y][x] = '<';
+    set_board_at(state, x, y, '<');
   } else if (newhead == 's') {
-    state->board[y][x] = 'v';
+    set_board_at(state, x, y, 'v');
   } else if (newhead == 'd') {
-    state->board[y][x] = '>';
+    set_board_at(state, x, y, '>');
   }
 }
 
 uint32_t snake_seed = 1;
 
 void random_turn(game_state_t* state, int snum) {
+  seeded_turn(state, snum, &snake_seed);
+}
+
+void seeded_turn(game_state_t* state, int snum, uint32_t* turn_seed) {
   snake_t* snake = &(state->snakes[snum]);
-  char cur_head = state->board[snake->head_y][snake->head_x];
+  char cur_head = get_board_at(state, snake->head_x, snake->head_y);
   char* heads = "<v>^";
   int i;
   for (i = 0; i < 4; ++i) {
     if (heads[i] == cur_head) break;
   }
-  if (det_rand(&snake_seed) % 2 == 0) {
+  if (det_rand(turn_seed) % 2 == 0) {
     i += 1;
   } else {
     i -= 1;
   }
-  i = i % 4;
+  i = (i + 4) % 4;
 
-  state->board[snake->head_y][snake->head_x] = heads[i];
+  set_board_at(state, snake->head_x, snake->head_y, heads[i]);
 }
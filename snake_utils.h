@@ -10,13 +10,24 @@
 #define KEY_MOVEDOWN 0x73
 #define KEY_MOVELEFT 0x61
 #define KEY_QUIT 0x71
+#define KEY_REWIND 0x72
 
 /* A simple deterministic random function. Look up LFSR to learn more! */
 uint32_t det_rand(uint32_t* state);
 
+/* Random state used by deterministic_food and random_turn respectively. */
+extern uint32_t seed;
+extern uint32_t snake_seed;
+
 /* Deterministically generates food on the board. */
 int deterministic_food(game_state_t* state);
 
+/*
+  Same as deterministic_food, but draws from food_seed instead of the global seed. Returns 0
+  without placing food if the board has no empty cell.
+*/
+int seeded_food(game_state_t* state, uint32_t* food_seed);
+
 /* Generates food in the top-left corner of the board. */
 int corner_food(game_state_t* state);
 
@@ -26,4 +37,7 @@ void redirect_snake(game_state_t* state, char newhead);
 /* Randomly causes the chosen snake to turn left or right. */
 void random_turn(game_state_t* state, int snum);
 
+/* Same as random_turn, but draws from turn_seed instead of snake_seed. */
+void seeded_turn(game_state_t* state, int snum, uint32_t* turn_seed);
+
 #endif
@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "daemon.h"
+#include "parallel.h"
+
+/*
+  Simulation daemon: serves boards over a Unix domain socket from long-lived worker processes, so
+  small boards cost a request instead of a process. Workers are forked up front and all accept
+  on the same socket; each runs one connection at a time on a single thread, since the food and
+  turn seeds are process-wide. A worker that dies is replaced.
+*/
+
+#define MAX_WORKERS 256
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int signum) {
+  stopping = 1;
+}
+
+static void run_worker(int listen_fd, unsigned int x_size, unsigned int y_size, unsigned int max_snakes,
+                       size_t max_board, uint64_t max_ticks) {
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  // One core per worker; boards are split across threads by running more workers instead
+  parallel_set_threads(1);
+  daemon_worker_t* worker = daemon_worker_create(x_size, y_size, max_snakes, max_board, max_ticks);
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      perror("accept");
+      exit(1);
+    }
+    daemon_serve(worker, fd);
+    close(fd);
+  }
+}
+
+/* Forks a worker. Returns its pid, or 0 if it couldn't be started. */
+static pid_t spawn_worker(int listen_fd, unsigned int x_size, unsigned int y_size, unsigned int max_snakes,
+                          size_t max_board, uint64_t max_ticks) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    run_worker(listen_fd, x_size, y_size, max_snakes, max_board, max_ticks);
+  }
+  if (pid < 0) {
+    perror("fork");
+    return 0;
+  }
+  return pid;
+}
+
+int main(int argc, char* argv[]) {
+  char* socket_path = DAEMON_SOCKET;
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned int num_workers = online < 1 ? 1 : (unsigned int) online;
+  unsigned int x_size = 14;
+  unsigned int y_size = 10;
+  unsigned int max_snakes = 2;
+  size_t max_board = DAEMON_MAX_BOARD;
+  uint64_t max_ticks = DAEMON_MAX_TICKS;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-S") == 0 && i < argc - 1) {
+      socket_path = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-j") == 0 && i < argc - 1) {
+      num_workers = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-w") == 0 && i < argc - 1) {
+      x_size = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-h") == 0 && i < argc - 1) {
+      y_size = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-s") == 0 && i < argc - 1) {
+      max_snakes = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-m") == 0 && i < argc - 1) {
+      max_board = strtoul(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+      max_ticks = strtoull(argv[i + 1], NULL, 10);
+      i++;
+      continue;
+    }
+    fprintf(stderr,
+            "Usage: %s [-S socket path] [-j workers] [-w width] [-h height] [-s snakes] [-m max board bytes] "
+            "[-t max ticks]\n",
+            argv[0]);
+    return 1;
+  }
+  if (num_workers < 1 || num_workers > MAX_WORKERS) {
+    fprintf(stderr, "-j must be between 1 and %d\n", MAX_WORKERS);
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path is too long\n", socket_path);
+    return 1;
+  }
+  strcpy(addr.sun_path, socket_path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  // A socket left behind by an earlier daemon would make bind fail
+  unlink(socket_path);
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0) {
+    fprintf(stderr, "%s: %s\n", socket_path, strerror(errno));
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  pid_t workers[MAX_WORKERS];
+  for (unsigned int i = 0; i < num_workers; i++) {
+    workers[i] = spawn_worker(listen_fd, x_size, y_size, max_snakes, max_board, max_ticks);
+  }
+  fprintf(stderr, "snaked: listening on %s with %u workers\n", socket_path, num_workers);
+
+  while (!stopping) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      if (errno == ECHILD) {
+        break;
+      }
+      continue;
+    }
+    for (unsigned int i = 0; i < num_workers && !stopping; i++) {
+      if (workers[i] == pid) {
+        fprintf(stderr, "snaked: worker %d died, starting another\n", (int) pid);
+        workers[i] = spawn_worker(listen_fd, x_size, y_size, max_snakes, max_board, max_ticks);
+      }
+    }
+  }
+
+  for (unsigned int i = 0; i < num_workers; i++) {
+    if (workers[i] > 0) {
+      kill(workers[i], SIGTERM);
+      waitpid(workers[i], NULL, 0);
+    }
+  }
+  close(listen_fd);
+  unlink(socket_path);
+  return 0;
+}
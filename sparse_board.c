@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sparse_board.h"
+
+#define SPARSE_MIN_CAPACITY 64
+
+static uint64_t chunk_key(uint32_t chunk_x, uint32_t chunk_y) {
+  return (uint64_t) chunk_y << 32 | chunk_x;
+}
+
+static size_t slot_of(sparse_board_t* board, uint32_t chunk_x, uint32_t chunk_y) {
+  uint64_t z = chunk_key(chunk_x, chunk_y);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return (z ^ (z >> 31)) & (board->capacity - 1);
+}
+
+/* Returns the slot holding the chunk, or the empty slot where it would go. */
+static size_t find_slot(sparse_board_t* board, uint32_t chunk_x, uint32_t chunk_y) {
+  size_t slot = slot_of(board, chunk_x, chunk_y);
+  while (board->slots[slot] != NULL
+         && (board->slots[slot]->chunk_x != chunk_x || board->slots[slot]->chunk_y != chunk_y)) {
+    slot = (slot + 1) & (board->capacity - 1);
+  }
+  return slot;
+}
+
+static void grow(sparse_board_t* board) {
+  sparse_chunk_t** old = board->slots;
+  size_t old_capacity = board->capacity;
+  board->capacity *= 2;
+  board->slots = calloc(board->capacity, sizeof(sparse_chunk_t*));
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i] != NULL) {
+      board->slots[find_slot(board, old[i]->chunk_x, old[i]->chunk_y)] = old[i];
+    }
+  }
+  free(old);
+}
+
+/* Frees the chunk in slot and closes the gap, so that probing never needs tombstones. */
+static void remove_slot(sparse_board_t* board, size_t slot) {
+  if (board->last == board->slots[slot]) {
+    board->last = NULL;
+  }
+  free(board->slots[slot]);
+  board->slots[slot] = NULL;
+  board->num_chunks -= 1;
+  size_t mask = board->capacity - 1;
+  size_t next = (slot + 1) & mask;
+  while (board->slots[next] != NULL) {
+    // A chunk can move back into the gap unless its home slot lies between the gap and it
+    size_t home = slot_of(board, board->slots[next]->chunk_x, board->slots[next]->chunk_y);
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      board->slots[slot] = board->slots[next];
+      board->slots[next] = NULL;
+      slot = next;
+    }
+    next = (next + 1) & mask;
+  }
+}
+
+/* An empty board of the given size, where every cell is ' '. */
+sparse_board_t* sparse_board_create(unsigned int x_size, unsigned int y_size) {
+  sparse_board_t* board = calloc(1, sizeof(sparse_board_t));
+  board->x_size = x_size;
+  board->y_size = y_size;
+  board->capacity = SPARSE_MIN_CAPACITY;
+  board->slots = calloc(board->capacity, sizeof(sparse_chunk_t*));
+  return board;
+}
+
+/* A copy of board that shares nothing with it. */
+sparse_board_t* sparse_board_clone(sparse_board_t* board) {
+  sparse_board_t* clone = malloc(sizeof(sparse_board_t));
+  *clone = *board;
+  clone->last = NULL;
+  clone->slots = calloc(clone->capacity, sizeof(sparse_chunk_t*));
+  for (size_t i = 0; i < board->capacity; i++) {
+    if (board->slots[i] != NULL) {
+      clone->slots[i] = malloc(sizeof(sparse_chunk_t));
+      memcpy(clone->slots[i], board->slots[i], sizeof(sparse_chunk_t));
+    }
+  }
+  return clone;
+}
+
+void sparse_board_destroy(sparse_board_t* board) {
+  for (size_t i = 0; i < board->capacity; i++) {
+    free(board->slots[i]);
+  }
+  free(board->slots);
+  free(board);
+}
+
+static sparse_chunk_t* find_chunk(sparse_board_t* board, uint32_t chunk_x, uint32_t chunk_y) {
+  sparse_chunk_t* last = board->last;
+  if (last != NULL && last->chunk_x == chunk_x && last->chunk_y == chunk_y) {
+    return last;
+  }
+  sparse_chunk_t* chunk = board->slots[find_slot(board, chunk_x, chunk_y)];
+  if (chunk != NULL) {
+    board->last = chunk;
+  }
+  return chunk;
+}
+
+char sparse_board_get(sparse_board_t* board, unsigned int x, unsigned int y) {
+  sparse_chunk_t* chunk = find_chunk(board, x >> SPARSE_CHUNK_BITS, y >> SPARSE_CHUNK_BITS);
+  if (chunk == NULL) {
+    return ' ';
+  }
+  return chunk->cells[(y & (SPARSE_CHUNK - 1)) * SPARSE_CHUNK + (x & (SPARSE_CHUNK - 1))];
+}
+
+void sparse_board_set(sparse_board_t* board, unsigned int x, unsigned int y, char ch) {
+  uint32_t chunk_x = x >> SPARSE_CHUNK_BITS;
+  uint32_t chunk_y = y >> SPARSE_CHUNK_BITS;
+  sparse_chunk_t* chunk = find_chunk(board, chunk_x, chunk_y);
+  if (chunk == NULL) {
+    if (ch == ' ') {
+      return;
+    }
+    if (2 * (board->num_chunks + 1) > board->capacity) {
+      grow(board);
+    }
+    chunk = malloc(sizeof(sparse_chunk_t));
+    chunk->chunk_x = chunk_x;
+    chunk->chunk_y = chunk_y;
+    chunk->used = 0;
+    memset(chunk->cells, ' ', sizeof(chunk->cells));
+    board->slots[find_slot(board, chunk_x, chunk_y)] = chunk;
+    board->num_chunks += 1;
+    board->last = chunk;
+  }
+
+  char* cell = &chunk->cells[(y & (SPARSE_CHUNK - 1)) * SPARSE_CHUNK + (x & (SPARSE_CHUNK - 1))];
+  chunk->used += (*cell == ' ') - (ch == ' ');
+  *cell = ch;
+  if (chunk->used == 0) {
+    remove_slot(board, find_slot(board, chunk_x, chunk_y));
+  }
+}
+
+static int compare_chunks(const void* a, const void* b) {
+  const sparse_chunk_t* x = *(const sparse_chunk_t* const*) a;
+  const sparse_chunk_t* y = *(const sparse_chunk_t* const*) b;
+  uint64_t x_key = chunk_key(x->chunk_x, x->chunk_y);
+  uint64_t y_key = chunk_key(y->chunk_x, y->chunk_y);
+  return (x_key > y_key) - (x_key < y_key);
+}
+
+/*
+  Returns a new array of every chunk, ordered by chunk row and then chunk column, followed by
+  NULL. The caller frees the array (but not the chunks).
+*/
+sparse_chunk_t** sparse_board_sorted_chunks(sparse_board_t* board) {
+  sparse_chunk_t** chunks = malloc((board->num_chunks + 1) * sizeof(sparse_chunk_t*));
+  size_t n = 0;
+  for (size_t i = 0; i < board->capacity; i++) {
+    if (board->slots[i] != NULL) {
+      chunks[n++] = board->slots[i];
+    }
+  }
+  qsort(chunks, n, sizeof(sparse_chunk_t*), compare_chunks);
+  chunks[n] = NULL;
+  return chunks;
+}
+
+bool sparse_board_equal(sparse_board_t* a, sparse_board_t* b) {
+  if (a->x_size != b->x_size || a->y_size != b->y_size || a->num_chunks != b->num_chunks) {
+    return false;
+  }
+  for (size_t i = 0; i < a->capacity; i++) {
+    sparse_chunk_t* chunk = a->slots[i];
+    if (chunk == NULL) {
+      continue;
+    }
+    sparse_chunk_t* other = b->slots[find_slot(b, chunk->chunk_x, chunk->chunk_y)];
+    if (other == NULL || memcmp(chunk->cells, other->cells, sizeof(chunk->cells)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Bytes allocated for the board, its table and its chunks. */
+size_t sparse_board_bytes(sparse_board_t* board) {
+  return sizeof(sparse_board_t) + board->capacity * sizeof(sparse_chunk_t*) + board->num_chunks * sizeof(sparse_chunk_t);
+}
@@ -0,0 +1,47 @@
+#ifndef _SNK_SPARSE_BOARD_H
+#define _SNK_SPARSE_BOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Chunks are SPARSE_CHUNK x SPARSE_CHUNK cells
+#define SPARSE_CHUNK_BITS 4
+#define SPARSE_CHUNK (1 << SPARSE_CHUNK_BITS)
+
+typedef struct sparse_chunk_t {
+  uint32_t chunk_x;
+  uint32_t chunk_y;
+  // Cells that aren't ' '; the chunk is freed when this drops to 0
+  unsigned int used;
+  char cells[SPARSE_CHUNK * SPARSE_CHUNK];
+} sparse_chunk_t;
+
+/*
+  A board that only stores the chunks holding something other than empty cells, so memory goes
+  with what is on the board rather than its area. Chunks are allocated on the first write of a
+  non-empty cell and released once their last one is cleared. They live in an open-addressing
+  table keyed by chunk coordinates; lookups remember the last chunk they found, since consecutive
+  reads are almost always close together. That makes reads writes too, so a sparse board must
+  not be read from several threads at once.
+*/
+typedef struct sparse_board_t {
+  unsigned int x_size;
+  unsigned int y_size;
+  // Power of two, at least twice num_chunks
+  size_t capacity;
+  size_t num_chunks;
+  sparse_chunk_t** slots;
+  sparse_chunk_t* last;
+} sparse_board_t;
+
+sparse_board_t* sparse_board_create(unsigned int x_size, unsigned int y_size);
+sparse_board_t* sparse_board_clone(sparse_board_t* board);
+void sparse_board_destroy(sparse_board_t* board);
+char sparse_board_get(sparse_board_t* board, unsigned int x, unsigned int y);
+void sparse_board_set(sparse_board_t* board, unsigned int x, unsigned int y, char ch);
+sparse_chunk_t** sparse_board_sorted_chunks(sparse_board_t* board);
+bool sparse_board_equal(sparse_board_t* a, sparse_board_t* b);
+size_t sparse_board_bytes(sparse_board_t* board);
+
+#endif
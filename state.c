@@ -1,52 +1,275 @@
+#include <errno.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "board_check.h"
+#include "parallel.h"
 #include "snake_utils.h"
 #include "state.h"
+#include "stats.h"
 
 /* Helper function definitions */
-static char get_board_at(game_state_t *state, int x, int y);
-static void set_board_at(game_state_t *state, int x, int y, char ch);
 static bool is_tail(char c);
 static bool is_snake(char c);
 static char body_to_tail(char c);
 static int incr_x(char c);
 static int incr_y(char c);
+static bool walk_to_head(game_state_t *state, snake_t *snake);
+static bool check_snakes(game_state_t *state, const char *filename, FILE *errors);
 static void find_head(game_state_t *state, int snum);
 static char next_square(game_state_t *state, int snum);
 static void update_tail(game_state_t *state, int snum);
 static void update_head(game_state_t *state, int snum);
 
+/*
+  Every board row is preceded by a reference count. clone_state shares rows between states, and the
+  first set_board_at into a shared row gives the writer its own copy.
+*/
+typedef struct board_row_t
+{
+  unsigned int refs;
+  char cells[];
+} board_row_t;
+
+static board_row_t *row_header(char *row)
+{
+  return (board_row_t *)(row - offsetof(board_row_t, cells));
+}
+
+/* Allocates size bytes from arena, or from malloc if arena is NULL. */
+static void *state_alloc(arena_t *arena, size_t size)
+{
+  if (arena != NULL)
+  {
+    return arena_alloc(arena, size);
+  }
+  return malloc(size);
+}
+
+/* Allocates one board row, with room for the trailing newline and null terminator. */
+static char *alloc_row(game_state_t *state)
+{
+  board_row_t *row = (board_row_t *)state_alloc(state->arena, sizeof(board_row_t) + (state->x_size + 2) * sizeof(char));
+  row->refs = 1;
+  return row->cells;
+}
+
+/* True if row still points into the file mapping of a mapped state (and so has no header). */
+static bool is_mapped_row(game_state_t *state, char *row)
+{
+  return state->map != NULL && row >= state->map->base && row < state->map->base + state->map->len;
+}
+
+/* Drops this state's reference to a row, freeing it once no state uses it. */
+static void release_row(game_state_t *state, char *cells)
+{
+  if (is_mapped_row(state, cells))
+  {
+    return;
+  }
+  board_row_t *row = row_header(cells);
+  row->refs -= 1;
+  if (row->refs == 0 && state->arena == NULL)
+  {
+    free(row);
+  }
+}
+
+/*
+  Zobrist key for ch at (x, y). Keys are derived by hashing the cell instead of being looked up in a
+  table, so boards of any size need no extra memory. Empty cells have a key of 0.
+*/
+static uint64_t cell_key(int x, int y, char ch)
+{
+  if (ch == ' ')
+  {
+    return 0;
+  }
+  uint64_t z = ((uint64_t)(unsigned int)y << 32 | (unsigned int)x) * 0x9E3779B97F4A7C15ULL + (unsigned char)ch;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/* Computes the hash of the whole board from scratch. state->hash should always be equal to this. */
+uint64_t board_hash(game_state_t *state)
+{
+  uint64_t hash = 0;
+  if (state->sparse != NULL)
+  {
+    // Empty cells hash to 0, so only the chunks need to be visited
+    sparse_board_t *sparse = state->sparse;
+    for (size_t i = 0; i < sparse->capacity; i += 1)
+    {
+      sparse_chunk_t *chunk = sparse->slots[i];
+      for (int c = 0; chunk != NULL && c < SPARSE_CHUNK * SPARSE_CHUNK; c += 1)
+      {
+        hash ^= cell_key(chunk->chunk_x * SPARSE_CHUNK + c % SPARSE_CHUNK, chunk->chunk_y * SPARSE_CHUNK + c / SPARSE_CHUNK,
+                         chunk->cells[c]);
+      }
+    }
+    return hash;
+  }
+  for (int y = 0; y < state->y_size; y += 1)
+  {
+    for (int x = 0; x < state->x_size; x += 1)
+    {
+      hash ^= cell_key(x, y, state->board[y][x]);
+    }
+  }
+  return hash;
+}
+
 /* Helper function to get a character from the board (already implemented for you). */
-static char get_board_at(game_state_t *state, int x, int y)
+char get_board_at(game_state_t *state, int x, int y)
 {
+  if (state->sparse != NULL)
+  {
+    return sparse_board_get(state->sparse, x, y);
+  }
   return state->board[y][x];
 }
 
-/* Helper function to set a character on the board (already implemented for you). */
-static void set_board_at(game_state_t *state, int x, int y, char ch)
+/* Forgets the tails recorded by load_board. */
+static void drop_tail_hints(game_state_t *state)
 {
+  if (state->arena == NULL)
+  {
+    free(state->tail_hints);
+  }
+  state->tail_hints = NULL;
+  state->num_tail_hints = 0;
+}
+
+/* set_board_at for sparse boards, kept apart so that writes to rows don't test for them. */
+static void set_sparse_board_at(game_state_t *state, int x, int y, char ch)
+{
+  char old_ch = sparse_board_get(state->sparse, x, y);
+  if (old_ch == ch)
+  {
+    return;
+  }
+  if (state->tail_hints != NULL)
+  {
+    drop_tail_hints(state);
+  }
+  sparse_board_set(state->sparse, x, y, ch);
+  state->hash ^= cell_key(x, y, old_ch) ^ cell_key(x, y, ch);
+  for (unsigned int i = 0; i < state->num_watchers; i += 1)
+  {
+    state->watchers[i].fn(state, x, y, old_ch, ch, state->watchers[i].ctx);
+  }
+}
+
+/* Helper function to set a character on the board. Shared rows are copied before the first write. */
+void set_board_at(game_state_t *state, int x, int y, char ch)
+{
+  if (state->sparse != NULL)
+  {
+    set_sparse_board_at(state, x, y, ch);
+    return;
+  }
+  char old_ch = state->board[y][x];
+  if (old_ch == ch)
+  {
+    return;
+  }
+  if (state->tail_hints != NULL)
+  {
+    drop_tail_hints(state);
+  }
+  if (is_mapped_row(state, state->board[y]))
+  {
+    // Mapped rows are written in place unless a clone shares the mapping
+    if (state->map->refs > 1)
+    {
+      char *copy = alloc_row(state);
+      memcpy(copy, state->board[y], state->x_size + 1);
+      copy[state->x_size + 1] = '\0';
+      state->board[y] = copy;
+    }
+  }
+  else
+  {
+    board_row_t *row = row_header(state->board[y]);
+    if (row->refs > 1)
+    {
+      char *copy = alloc_row(state);
+      memcpy(copy, row->cells, state->x_size + 2);
+      row->refs -= 1;
+      state->board[y] = copy;
+    }
+  }
   state->board[y][x] = ch;
+  state->hash ^= cell_key(x, y, old_ch) ^ cell_key(x, y, ch);
+  for (unsigned int i = 0; i < state->num_watchers; i += 1)
+  {
+    state->watchers[i].fn(state, x, y, old_ch, ch, state->watchers[i].ctx);
+  }
+}
+
+/* Registers fn to be called on every board change. Returns false if there is no free watcher slot. */
+bool watch_board(game_state_t *state, board_watcher_t fn, void *ctx)
+{
+  if (state->num_watchers == MAX_BOARD_WATCHERS)
+  {
+    return false;
+  }
+  state->watchers[state->num_watchers].fn = fn;
+  state->watchers[state->num_watchers].ctx = ctx;
+  state->num_watchers += 1;
+  return true;
+}
+
+/* Removes a watcher previously added with watch_board. */
+void unwatch_board(game_state_t *state, board_watcher_t fn, void *ctx)
+{
+  for (unsigned int i = 0; i < state->num_watchers; i += 1)
+  {
+    if (state->watchers[i].fn == fn && state->watchers[i].ctx == ctx)
+    {
+      state->num_watchers -= 1;
+      state->watchers[i] = state->watchers[state->num_watchers];
+      return;
+    }
+  }
 }
 
 /* Task 1 */
 game_state_t *create_default_state()
 {
-  game_state_t *state = (game_state_t *)malloc(sizeof(game_state_t));
+  return create_default_state_in(NULL);
+}
+
+/* Same as create_default_state, but everything is allocated from arena (if it is not NULL). */
+game_state_t *create_default_state_in(arena_t *arena)
+{
+  game_state_t *state = (game_state_t *)state_alloc(arena, sizeof(game_state_t));
+  state->arena = arena;
+  state->map = NULL;
+  state->sparse = NULL;
+  state->num_watchers = 0;
   state->x_size = 14;
   state->y_size = 10;
   state->num_snakes = 1;
-  state->snakes = (snake_t *)malloc(sizeof(snake_t));
+  state->num_tail_hints = 0;
+  state->tail_hints = NULL;
+  state->snakes = (snake_t *)state_alloc(arena, sizeof(snake_t));
   state->snakes->head_x = 5;
   state->snakes->head_y = 4;
   state->snakes->tail_x = 4;
   state->snakes->tail_y = 4;
   state->snakes->live = true;
-  state->board = (char **)malloc(state->y_size * sizeof(char *));
+  state->num_live = 1;
+  state->live_snakes = (unsigned int *)state_alloc(arena, sizeof(unsigned int));
+  state->live_snakes[0] = 0;
+  state->board = (char **)state_alloc(arena, state->y_size * sizeof(char *));
   for (int i = 0; i < state->y_size; i += 1)
   {
-    state->board[i] = (char *)malloc((state->x_size + 1) * sizeof(char));
+    state->board[i] = alloc_row(state);
   }
   char *wall_1 = "##############\n";
   char *wall_2 = "#            #\n";
@@ -60,6 +283,7 @@ game_state_t *create_default_state()
   state->board[2][9] = '*';
   state->board[4][4] = 'd';
   state->board[4][5] = '>';
+  state->hash = board_hash(state);
 
   return state;
 }
@@ -67,32 +291,139 @@ game_state_t *create_default_state()
 /* Task 2 */
 void free_state(game_state_t *state)
 {
-  for (int i = 0; i < state->y_size; i += 1)
+  // Arena-backed states are released all at once by arena_reset
+  if (state->arena != NULL)
+  {
+    return;
+  }
+  if (state->sparse != NULL)
+  {
+    sparse_board_destroy(state->sparse);
+  }
+  for (int i = 0; state->board != NULL && i < state->y_size; i += 1)
+  {
+    release_row(state, state->board[i]);
+  }
+  if (state->map != NULL)
   {
-    free(state->board[i]);
+    board_map_release(state->map);
   }
   free(state->board);
   free(state->snakes);
+  free(state->live_snakes);
+  free(state->tail_hints);
   free(state);
   return;
 }
 
+/*
+  Makes a copy of state that shares every board row with it. Rows are only copied when one of the
+  two states first writes to them, so cloning costs one pointer per row plus the snake table. The
+  clone is allocated from the same arena as state. Sparse boards are copied outright.
+*/
+game_state_t *clone_state(game_state_t *state)
+{
+  game_state_t *clone = (game_state_t *)state_alloc(state->arena, sizeof(game_state_t));
+  *clone = *state;
+  clone->num_watchers = 0;
+  clone->num_tail_hints = 0;
+  clone->tail_hints = NULL;
+  clone->snakes = (snake_t *)state_alloc(state->arena, state->num_snakes * sizeof(snake_t));
+  if (state->num_snakes > 0)
+  {
+    memcpy(clone->snakes, state->snakes, state->num_snakes * sizeof(snake_t));
+  }
+  if (state->live_snakes != NULL)
+  {
+    clone->live_snakes = (unsigned int *)state_alloc(state->arena, (state->num_live + 1) * sizeof(unsigned int));
+    memcpy(clone->live_snakes, state->live_snakes, state->num_live * sizeof(unsigned int));
+  }
+  if (state->sparse != NULL)
+  {
+    clone->sparse = sparse_board_clone(state->sparse);
+    return clone;
+  }
+  clone->board = (char **)state_alloc(state->arena, state->y_size * sizeof(char *));
+  for (int i = 0; i < state->y_size; i += 1)
+  {
+    if (!is_mapped_row(state, state->board[i]))
+    {
+      row_header(state->board[i])->refs += 1;
+    }
+    clone->board[i] = state->board[i];
+  }
+  if (state->map != NULL)
+  {
+    state->map->refs += 1;
+  }
+  return clone;
+}
+
+/* Copies row y of every chunk in the band starting at band (sorted, NULL-terminated) into row, or clears it. */
+static void fill_sparse_row(game_state_t *state, sparse_chunk_t **band, unsigned int y, char *row, bool clear)
+{
+  for (sparse_chunk_t **chunk = band; *chunk != NULL && (*chunk)->chunk_y == y / SPARSE_CHUNK; chunk += 1)
+  {
+    size_t x = (size_t)(*chunk)->chunk_x * SPARSE_CHUNK;
+    size_t width = state->x_size - x < SPARSE_CHUNK ? state->x_size - x : SPARSE_CHUNK;
+    if (clear)
+    {
+      memset(row + x, ' ', width);
+    }
+    else
+    {
+      memcpy(row + x, (*chunk)->cells + (y % SPARSE_CHUNK) * SPARSE_CHUNK, width);
+    }
+  }
+}
+
+/* Streams a sparse board out a row at a time. Rows start out empty and only the chunks crossing them are filled in. */
+static void print_sparse_board(game_state_t *state, FILE *fp)
+{
+  sparse_chunk_t **chunks = sparse_board_sorted_chunks(state->sparse);
+  char *row = (char *)malloc(state->x_size + 1);
+  memset(row, ' ', state->x_size);
+  row[state->x_size] = '\n';
+  sparse_chunk_t **band = chunks;
+  for (unsigned int y = 0; y < state->y_size; y += 1)
+  {
+    while (*band != NULL && (*band)->chunk_y < y / SPARSE_CHUNK)
+    {
+      band += 1;
+    }
+    fill_sparse_row(state, band, y, row, false);
+    fwrite(row, 1, state->x_size + 1, fp);
+    fill_sparse_row(state, band, y, row, true);
+  }
+  free(row);
+  free(chunks);
+}
+
 /* Task 3 */
 void print_board(game_state_t *state, FILE *fp)
 {
-  for (int i = 0; i < state->y_size; i += 1)
+  STATS_START(STATS_PRINT_BOARD);
+  if (state->sparse != NULL)
   {
-    fprintf(fp, "%s", state->board[i]);
+    print_sparse_board(state, fp);
   }
+  // Rows always end in a newline, but mapped rows have no null terminator after it
+  for (int i = 0; state->board != NULL && i < state->y_size; i += 1)
+  {
+    fwrite(state->board[i], 1, state->x_size + 1, fp);
+  }
+  STATS_STOP(STATS_PRINT_BOARD);
   return;
 }
 
 /* Saves the current state into filename (already implemented for you). */
 void save_board(game_state_t *state, char *filename)
 {
+  STATS_START(STATS_SAVE_BOARD);
   FILE *f = fopen(filename, "w");
   print_board(state, f);
   fclose(f);
+  STATS_STOP(STATS_SAVE_BOARD);
 }
 
 /* Task 4.1 */
@@ -156,169 +487,1052 @@ static int incr_y(char c)
 /* Task 4.2 */
 static char next_square(game_state_t *state, int snum)
 {
+  STATS_START(STATS_NEXT_SQUARE);
   snake_t snake = state->snakes[snum];
-  char head = get_board_at(state, snake.head_x, snake.head_y);
+  char head = state->board[snake.head_y][snake.head_x];
   int pos_x_next = snake.head_x + incr_x(head);
   int pos_y_next = snake.head_y + incr_y(head);
-  return get_board_at(state, pos_x_next, pos_y_next);
+  char next = state->board[pos_y_next][pos_x_next];
+  STATS_STOP(STATS_NEXT_SQUARE);
+  return next;
 }
 
 /* Task 4.3 */
 static void update_head(game_state_t *state, int snum)
 {
-  char head = get_board_at(state, state->snakes[snum].head_x, state->snakes[snum].head_y);
+  STATS_START(STATS_UPDATE_HEAD);
+  char head = state->board[state->snakes[snum].head_y][state->snakes[snum].head_x];
   int pos_x_next = state->snakes[snum].head_x + incr_x(head);
   int pos_y_next = state->snakes[snum].head_y + incr_y(head);
   set_board_at(state, pos_x_next, pos_y_next, head);
   state->snakes[snum].head_x = pos_x_next;
   state->snakes[snum].head_y = pos_y_next;
+  STATS_STOP(STATS_UPDATE_HEAD);
   return;
 }
 
 /* Task 4.4 */
 static void update_tail(game_state_t *state, int snum)
 {
-  char tail = get_board_at(state, state->snakes[snum].tail_x, state->snakes[snum].tail_y);
+  STATS_START(STATS_UPDATE_TAIL);
+  char tail = state->board[state->snakes[snum].tail_y][state->snakes[snum].tail_x];
   int pos_x_next = state->snakes[snum].tail_x + incr_x(tail);
   int pos_y_next = state->snakes[snum].tail_y + incr_y(tail);
-  char tail_before = get_board_at(state, pos_x_next, pos_y_next);
+  char tail_before = state->board[pos_y_next][pos_x_next];
   set_board_at(state, state->snakes[snum].tail_x, state->snakes[snum].tail_y, ' ');
   set_board_at(state, pos_x_next, pos_y_next, body_to_tail(tail_before));
   state->snakes[snum].tail_x = pos_x_next;
   state->snakes[snum].tail_y = pos_y_next;
+  STATS_STOP(STATS_UPDATE_TAIL);
   return;
 }
 
-/* Task 4.5 */
-void update_state(game_state_t *state, int (*add_food)(game_state_t *state))
+/*
+  update_state for sparse boards. The helpers above read rows directly so that ordinary boards never
+  test for sparse ones; this makes the same moves through get_board_at instead.
+*/
+static void update_sparse_state(game_state_t *state, int (*add_food)(game_state_t *state))
 {
-  for (int i = 0; i < 4; i += 1)
+  unsigned int kept = 0;
+  for (unsigned int j = 0; j < state->num_live; j += 1)
   {
-    int sum = state->snakes[i].head_x * state->snakes[i].head_y;
-    if (sum > state->x_size * state->y_size || sum <= 0)
+    int i = state->live_snakes[j];
+    snake_t *snake = &state->snakes[i];
+    STATS_START(STATS_NEXT_SQUARE);
+    char head = get_board_at(state, snake->head_x, snake->head_y);
+    int head_x = snake->head_x + incr_x(head);
+    int head_y = snake->head_y + incr_y(head);
+    char next = get_board_at(state, head_x, head_y);
+    STATS_STOP(STATS_NEXT_SQUARE);
+    if (next == '#' || is_snake(next) || is_tail(next))
     {
+      snake->live = false;
+      set_board_at(state, snake->head_x, snake->head_y, 'x');
       continue;
     }
-    // for (int j = 0; j < state->y_size; j += 1)
-    // {
-    //   printf("before update: %s", state->board[j]);
-    // }
-    // printf("snake-%i head pos before: (%i, %i)\n", i, state->snakes[i].head_x, state->snakes[i].head_y);
-    // printf("snake-%i tail pos before: (%i, %i)\n", i, state->snakes[i].tail_x, state->snakes[i].tail_y);
+    state->live_snakes[kept] = i;
+    kept += 1;
+    STATS_START(STATS_UPDATE_HEAD);
+    set_board_at(state, head_x, head_y, head);
+    snake->head_x = head_x;
+    snake->head_y = head_y;
+    STATS_STOP(STATS_UPDATE_HEAD);
+    if (next == '*')
+    {
+      STATS_START(STATS_ADD_FOOD);
+      add_food(state);
+      STATS_STOP(STATS_ADD_FOOD);
+      continue;
+    }
+    STATS_START(STATS_UPDATE_TAIL);
+    char tail = get_board_at(state, snake->tail_x, snake->tail_y);
+    int tail_x = snake->tail_x + incr_x(tail);
+    int tail_y = snake->tail_y + incr_y(tail);
+    char tail_before = get_board_at(state, tail_x, tail_y);
+    set_board_at(state, snake->tail_x, snake->tail_y, ' ');
+    set_board_at(state, tail_x, tail_y, body_to_tail(tail_before));
+    snake->tail_x = tail_x;
+    snake->tail_y = tail_y;
+    STATS_STOP(STATS_UPDATE_TAIL);
+  }
+  state->num_live = kept;
+}
+
+/* Task 4.5 */
+void update_state(game_state_t *state, int (*add_food)(game_state_t *state))
+{
+  if (state->live_snakes == NULL)
+  {
+    refresh_live_snakes(state);
+  }
+  if (state->sparse != NULL)
+  {
+    update_sparse_state(state, add_food);
+    return;
+  }
+  // Snakes move in the order they are numbered; the list is compacted in place as they die
+  unsigned int kept = 0;
+  for (unsigned int j = 0; j < state->num_live; j += 1)
+  {
+    int i = state->live_snakes[j];
     char next = next_square(state, i);
     if (next == '#' || is_snake(next) || is_tail(next))
     {
       state->snakes[i].live = false;
       set_board_at(state, state->snakes[i].head_x, state->snakes[i].head_y, 'x');
+      continue;
     }
-    else if (next == '*')
+    state->live_snakes[kept] = i;
+    kept += 1;
+    if (next == '*')
     {
       update_head(state, i);
+      STATS_START(STATS_ADD_FOOD);
       add_food(state);
+      STATS_STOP(STATS_ADD_FOOD);
     }
     else
     {
       update_head(state, i);
       update_tail(state, i);
     }
-    // for (int j = 0; j < state->y_size; j += 1)
-    // {
-    //   printf("after update: %s", state->board[j]);
-    // }
-    // printf("snake-%i head pos after: (%i, %i)\n", i, state->snakes[i].head_x, state->snakes[i].head_y);
-    // printf("snake-%i tail pos after: (%i, %i)\n", i, state->snakes[i].tail_x, state->snakes[i].tail_y);
   }
+  state->num_live = kept;
   return;
 }
 
 /* Task 5 */
 game_state_t *load_board(char *filename)
 {
-  FILE *f = fopen(filename, "r");
-  char c = getc(f);
-  game_state_t *state = (game_state_t *)malloc(sizeof(game_state_t));
-  int length_x = 0;
-  int length_y = 0;
-  while (c != EOF)
+  return load_board_in(NULL, filename);
+}
+
+/* Tails found in one chunk of rows, in row-major order. */
+typedef struct tail_list_t
+{
+  snake_t *tails;
+  unsigned int count;
+  unsigned int capacity;
+} tail_list_t;
+
+/* Per-chunk results of loading or scanning a range of rows. */
+typedef struct board_chunk_t
+{
+  tail_list_t tails;
+  uint64_t hash;
+  // Set to the first problem found in the chunk, if any
+  const char *error;
+  size_t error_row;
+  size_t error_col;
+} board_chunk_t;
+
+typedef struct board_job_t
+{
+  game_state_t *state;
+  // The file being loaded, or NULL when scanning rows that are already on the board
+  const char *buf;
+  size_t len;
+  // The row that must be all wall along with the first, or y_size if the end of the board is missing
+  size_t last_row;
+  board_chunk_t *chunks;
+} board_job_t;
+
+// Rows are only split across threads in chunks of at least this many bytes
+#define BYTES_PER_CHUNK (1 << 20)
+#define HEADS_PER_CHUNK 1024
+
+static void add_tail(tail_list_t *list, unsigned int x, unsigned int y)
+{
+  if (list->count == list->capacity)
   {
-    if (c == '\n')
+    list->capacity = list->capacity * 2 + 16;
+    list->tails = (snake_t *)realloc(list->tails, list->capacity * sizeof(snake_t));
+  }
+  list->tails[list->count].tail_x = x;
+  list->tails[list->count].tail_y = y;
+  list->tails[list->count].live = true;
+  list->count += 1;
+}
+
+static size_t rows_per_chunk(game_state_t *state)
+{
+  return BYTES_PER_CHUNK / (state->x_size + 1) + 1;
+}
+
+/*
+  Copies rows [begin, end) of the file into the board, validating them and recording their tails.
+  Without a file, validates the rows that are already on the board.
+*/
+static void load_rows(unsigned int chunk, size_t begin, size_t end, void *ctx)
+{
+  board_job_t *job = (board_job_t *)ctx;
+  board_chunk_t *out = &job->chunks[chunk];
+  size_t x_size = job->state->x_size;
+  for (size_t y = begin; y < end; y += 1)
+  {
+    // Streamed boards already have their rows in place, complete with newlines
+    const char *src = job->buf != NULL ? job->buf + y * (x_size + 1) : job->state->board[y];
+    // Only the last row of a file can be cut short, and it may leave out its newline
+    size_t avail = job->buf != NULL ? job->len - y * (x_size + 1) : x_size + 1;
+    size_t scan = avail < x_size + 1 ? avail : x_size + 1;
+    const char *newline = (const char *)memchr(src, '\n', scan);
+    size_t len = newline != NULL ? (size_t)(newline - src) : scan;
+    // A row of the wrong width is checked like an inner one, since streamed loads can't tell it is the last
+    bool edge = (y == 0 || y == job->last_row) && len == x_size;
+    out->error = board_check_row(src, len, x_size, edge, &out->error_col);
+    if (out->error != NULL)
     {
-      length_y += 1;
-      length_x += 1;
+      out->error_row = y;
+      return;
     }
-    else
+    // Empty cells neither hash nor hold tails, so only the others are visited
+    size_t x = board_next_cell(src, x_size);
+    while (x < x_size)
+    {
+      if (is_tail(src[x]))
+      {
+        add_tail(&out->tails, x, y);
+      }
+      out->hash ^= cell_key(x, y, src[x]);
+      x += 1 + board_next_cell(src + x + 1, x_size - x - 1);
+    }
+    // Mapped rows already are the file
+    char *row = job->state->board[y];
+    if (row != src)
     {
-      length_x += 1;
+      memcpy(row, src, x_size);
+      row[x_size] = '\n';
+      row[x_size + 1] = '\0';
     }
-    c = getc(f);
   }
-  rewind(f);
-  length_x = (length_x / length_y) - 1;
-  char **board = (char **)malloc(length_y * sizeof(char *));
-  for (int i = 0; i < length_y; i += 1)
+}
+
+/* Records the tails in rows [begin, end) of the board. */
+static void scan_rows(unsigned int chunk, size_t begin, size_t end, void *ctx)
+{
+  board_job_t *job = (board_job_t *)ctx;
+  tail_list_t *tails = &job->chunks[chunk].tails;
+  for (size_t y = begin; y < end; y += 1)
   {
-    board[i] = (char *)malloc((length_x + 1) * sizeof(char));
+    const char *row = job->state->board[y];
+    for (size_t x = 0; x < job->state->x_size; x += 1)
+    {
+      if (is_tail(row[x]))
+      {
+        add_tail(tails, x, y);
+      }
+    }
   }
-  // fread(board, length_x + 1, length_y, f);
-  for (int i = 0; i < length_y; i += 1)
+}
+
+/* Concatenates the tails found by each chunk into state->tail_hints and frees the chunk lists. */
+static void merge_tails(game_state_t *state, board_chunk_t *chunks, unsigned int num_chunks)
+{
+  unsigned int total = 0;
+  for (unsigned int c = 0; c < num_chunks; c += 1)
   {
-    fgets(board[i], 128, f);
+    total += chunks[c].tails.count;
   }
-  state->board = board;
-  state->x_size = length_x;
-  state->y_size = length_y;
-  fclose(f);
+  // Never NULL, so that a board without snakes still counts as scanned
+  state->tail_hints = (snake_t *)state_alloc(state->arena, (total > 0 ? total : 1) * sizeof(snake_t));
+  state->num_tail_hints = total;
+  unsigned int next = 0;
+  for (unsigned int c = 0; c < num_chunks; c += 1)
+  {
+    if (chunks[c].tails.count > 0)
+    {
+      memcpy(state->tail_hints + next, chunks[c].tails.tails, chunks[c].tails.count * sizeof(snake_t));
+    }
+    next += chunks[c].tails.count;
+    free(chunks[c].tails.tails);
+  }
+}
+
+/* A state for a board being loaded, with no rows yet. */
+static game_state_t *new_loaded_state(arena_t *arena, size_t x_size, board_map_t *map)
+{
+  game_state_t *state = (game_state_t *)state_alloc(arena, sizeof(game_state_t));
+  state->arena = arena;
+  state->map = map;
+  state->sparse = NULL;
+  state->num_watchers = 0;
+  state->x_size = x_size;
+  state->y_size = 0;
+  state->board = NULL;
+  state->num_snakes = 0;
+  state->snakes = NULL;
+  state->num_live = 0;
+  state->live_snakes = NULL;
+  state->num_tail_hints = 0;
+  state->tail_hints = NULL;
   return state;
 }
 
-/* Task 6.1 */
-static void find_head(game_state_t *state, int snum)
+/*
+  Validates the rows of a state being loaded in parallel, copying them out of buf first unless buf
+  is NULL, and fills in its hash and tail hints. complete is false if rows are missing from the
+  end, so that the last one isn't held to being a wall. The first problem is reported to errors as
+  file:row:column, frees the state and makes this return NULL.
+*/
+static game_state_t *check_rows(game_state_t *state, const char *filename, const char *buf, size_t len, bool complete,
+                                FILE *errors)
+{
+  size_t y_size = state->y_size;
+  unsigned int num_chunks = parallel_chunks(y_size, rows_per_chunk(state));
+  board_job_t job;
+  job.state = state;
+  job.buf = buf;
+  job.len = len;
+  job.last_row = complete ? y_size - 1 : y_size;
+  job.chunks = (board_chunk_t *)calloc(num_chunks, sizeof(board_chunk_t));
+  parallel_run(num_chunks, y_size, load_rows, &job);
+
+  state->hash = 0;
+  for (unsigned int c = 0; c < num_chunks; c += 1)
+  {
+    board_chunk_t *chunk = &job.chunks[c];
+    if (chunk->error != NULL)
+    {
+      fprintf(errors, "%s:%zu:%zu: %s\n", filename, chunk->error_row + 1, chunk->error_col + 1, chunk->error);
+      for (c = 0; c < num_chunks; c += 1)
+      {
+        free(job.chunks[c].tails.tails);
+      }
+      free(job.chunks);
+      free_state(state);
+      return NULL;
+    }
+    state->hash ^= chunk->hash;
+  }
+  merge_tails(state, job.chunks, num_chunks);
+  free(job.chunks);
+  // Rows missing from the end could be walked into, so only a whole board is checked for loops
+  if (complete && !check_snakes(state, filename, errors))
+  {
+    free_state(state);
+    return NULL;
+  }
+  return state;
+}
+
+/*
+  Builds a state from the contents of a .snk file that is already in memory. Every row must be as
+  long as the first one. Rows are parsed and validated in parallel; problems are reported to
+  errors as file:row:column and make this return NULL. If map is not NULL, buf is its mapping and
+  the rows point straight into it instead of being copied; the state takes over the caller's
+  reference to map.
+*/
+static game_state_t *parse_board(arena_t *arena, const char *filename, char *buf, size_t len, board_map_t *map,
+                                 FILE *errors)
 {
-  int tail_x = state->snakes[snum].tail_x;
-  int tail_y = state->snakes[snum].tail_y;
-  int pos_x = tail_x;
-  int pos_y = tail_y;
-  int pos_x_next = tail_x;
-  int pos_y_next = tail_y;
-  char square = get_board_at(state, tail_x, tail_y);
+  const char *newline = (const char *)memchr(buf, '\n', len);
+  size_t x_size = newline == NULL ? len : (size_t)(newline - buf);
+  if (x_size == 0)
+  {
+    fprintf(errors, "%s:1:1: board is empty\n", filename);
+    if (map != NULL)
+    {
+      board_map_release(map);
+    }
+    return NULL;
+  }
+  size_t y_size = (len + x_size) / (x_size + 1);
+
+  game_state_t *state = new_loaded_state(arena, x_size, map);
+  state->y_size = y_size;
+  state->board = (char **)state_alloc(arena, y_size * sizeof(char *));
+  for (size_t i = 0; i < y_size; i += 1)
+  {
+    state->board[i] = map != NULL ? buf + i * (x_size + 1) : alloc_row(state);
+  }
+  return check_rows(state, filename, buf, len, true, errors);
+}
+
+// Bytes read at a time when streaming a board
+#define READ_BLOCK_SIZE (1 << 20)
+
+/*
+  Splits a stream into rows in a single pass, so boards can come from pipes. Rows are handed out
+  without their newline, and a carriage return right before it is dropped too, so CRLF files load
+  as they are.
+*/
+typedef struct row_reader_t
+{
+  FILE *f;
+  // The name used in error messages
+  const char *name;
+  char *block;
+  size_t block_len;
+  size_t pos;
+  // A row that spans blocks is gathered here
+  char *carry;
+  size_t carry_len;
+  size_t carry_capacity;
+  bool eof;
+  bool failed;
+} row_reader_t;
+
+/* Opens filename for reading, or stdin if it is "-". Reports to stderr and returns false on failure. */
+static bool open_rows(row_reader_t *reader, const char *filename)
+{
+  memset(reader, 0, sizeof(row_reader_t));
+  bool from_stdin = strcmp(filename, "-") == 0;
+  reader->name = from_stdin ? "stdin" : filename;
+  reader->f = from_stdin ? stdin : fopen(filename, "rb");
+  if (reader->f == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    return false;
+  }
+  reader->block = (char *)malloc(READ_BLOCK_SIZE);
+  return true;
+}
+
+static void close_rows(row_reader_t *reader)
+{
+  if (reader->f != stdin)
+  {
+    fclose(reader->f);
+  }
+  free(reader->block);
+  free(reader->carry);
+}
+
+static void carry_bytes(row_reader_t *reader, const char *bytes, size_t len)
+{
+  if (reader->carry_len + len > reader->carry_capacity)
+  {
+    reader->carry_capacity = (reader->carry_len + len) * 2;
+    reader->carry = (char *)realloc(reader->carry, reader->carry_capacity);
+  }
+  memcpy(reader->carry + reader->carry_len, bytes, len);
+  reader->carry_len += len;
+}
+
+/*
+  Points row at the next row and len at its length; both stay valid until the next call. Returns
+  false once the stream is exhausted, but a last row without a newline is still handed out. Read
+  errors are reported to stderr and set reader->failed.
+*/
+static bool next_row(row_reader_t *reader, const char **row, size_t *len)
+{
+  reader->carry_len = 0;
+  while (!reader->eof)
+  {
+    const char *start = reader->block + reader->pos;
+    size_t avail = reader->block_len - reader->pos;
+    const char *newline = (const char *)memchr(start, '\n', avail);
+    if (newline != NULL)
+    {
+      size_t n = newline - start;
+      reader->pos += n + 1;
+      if (reader->carry_len > 0)
+      {
+        carry_bytes(reader, start, n);
+        start = reader->carry;
+        n = reader->carry_len;
+      }
+      *row = start;
+      *len = n > 0 && start[n - 1] == '\r' ? n - 1 : n;
+      return true;
+    }
+    if (avail > 0)
+    {
+      carry_bytes(reader, start, avail);
+    }
+    reader->block_len = fread(reader->block, 1, READ_BLOCK_SIZE, reader->f);
+    reader->pos = 0;
+    if (reader->block_len == 0)
+    {
+      reader->eof = true;
+      if (ferror(reader->f))
+      {
+        fprintf(stderr, "%s: could not read file\n", reader->name);
+        reader->failed = true;
+        return false;
+      }
+    }
+  }
+  if (reader->carry_len == 0)
+  {
+    return false;
+  }
+  *row = reader->carry;
+  *len = reader->carry[reader->carry_len - 1] == '\r' ? reader->carry_len - 1 : reader->carry_len;
+  return true;
+}
+
+/*
+  Checks a row against the width of the first one, and the rest of it when its width is wrong.
+  Returns the problem and sets col to where it is, or returns NULL.
+*/
+static const char *check_row_width(const char *row, size_t len, size_t x_size, size_t *col)
+{
+  if (len == x_size)
+  {
+    return NULL;
+  }
+  return board_check_row(row, len, x_size, false, col);
+}
+
+/* Same as load_board, but everything is allocated from arena (if it is not NULL). */
+game_state_t *load_board_in(arena_t *arena, char *filename)
+{
+  STATS_START(STATS_LOAD_BOARD);
+  row_reader_t reader;
+  if (!open_rows(&reader, filename))
+  {
+    STATS_STOP(STATS_LOAD_BOARD);
+    return NULL;
+  }
+
+  // Rows are copied out as soon as they are complete, and their characters checked afterwards
+  game_state_t *state = NULL;
+  char **rows = NULL;
+  size_t num_rows = 0;
+  size_t capacity = 0;
+  const char *error = NULL;
+  size_t error_col = 0;
+  const char *row;
+  size_t len;
+  while (next_row(&reader, &row, &len))
+  {
+    if (state == NULL)
+    {
+      if (len == 0)
+      {
+        break;
+      }
+      state = new_loaded_state(arena, len, NULL);
+    }
+    error = check_row_width(row, len, state->x_size, &error_col);
+    if (error != NULL)
+    {
+      break;
+    }
+    if (num_rows == capacity)
+    {
+      capacity = capacity * 2 + 64;
+      rows = (char **)realloc(rows, capacity * sizeof(char *));
+    }
+    char *copy = alloc_row(state);
+    memcpy(copy, row, len);
+    copy[len] = '\n';
+    copy[len + 1] = '\0';
+    rows[num_rows] = copy;
+    num_rows += 1;
+  }
+  bool failed = reader.failed;
+  const char *name = reader.name;
+  close_rows(&reader);
+
+  if (state == NULL)
+  {
+    if (!failed)
+    {
+      fprintf(stderr, "%s:1:1: board is empty\n", name);
+    }
+    STATS_STOP(STATS_LOAD_BOARD);
+    return NULL;
+  }
+  state->y_size = num_rows;
+  if (arena == NULL)
+  {
+    state->board = rows;
+  }
+  else
+  {
+    state->board = (char **)state_alloc(arena, num_rows * sizeof(char *));
+    memcpy(state->board, rows, num_rows * sizeof(char *));
+    free(rows);
+  }
+  // A bad character in an earlier row is reported ahead of a row of the wrong width
+  state = check_rows(state, name, NULL, 0, error == NULL && !failed, stderr);
+  if (state != NULL && (error != NULL || failed))
+  {
+    if (error != NULL)
+    {
+      fprintf(stderr, "%s:%zu:%zu: %s\n", name, num_rows + 1, error_col + 1, error);
+    }
+    free_state(state);
+    state = NULL;
+  }
+  STATS_STOP(STATS_LOAD_BOARD);
+  return state;
+}
+
+/*
+  Same as load_board, but parses a board that is already in memory. name is only used in error
+  messages. buf is not modified or kept.
+*/
+game_state_t *load_board_from_memory(const char *name, char *buf, size_t len)
+{
+  return load_board_from_memory_in(NULL, name, buf, len, stderr);
+}
+
+/*
+  Same as load_board_from_memory, but everything is allocated from arena (if it is not NULL) and
+  problems with the board are reported to errors instead of stderr.
+*/
+game_state_t *load_board_from_memory_in(arena_t *arena, const char *name, char *buf, size_t len, FILE *errors)
+{
+  STATS_START(STATS_LOAD_BOARD);
+  game_state_t *state = parse_board(arena, name, buf, len, NULL, errors);
+  STATS_STOP(STATS_LOAD_BOARD);
+  return state;
+}
+
+/*
+  Follows a snake from its tail to its head. Only reads the board, so snakes can be walked in
+  parallel. Returns false if the body loops back on itself instead of ending in a head.
+*/
+static bool walk_to_head(game_state_t *state, snake_t *snake)
+{
+  int pos_x = snake->tail_x;
+  int pos_y = snake->tail_y;
+  int pos_x_next = pos_x;
+  int pos_y_next = pos_y;
+  // Rows are read directly; only sparse boards need get_board_at
+  bool sparse = state->sparse != NULL;
+  char square = get_board_at(state, pos_x, pos_y);
   char square_next = square;
-  // printf("square: %c, tail(%i, %i)\n", square, tail_x, tail_y);
+  // Brent's cycle detection: the walk remembers where it was after each power of two steps, and
+  // only a loop brings it back there, at most a few times the length of the body later
+  int saved_x = -1;
+  int saved_y = -1;
+  size_t power = 1;
+  size_t left = 1;
 
-  while (is_snake(square_next) || is_tail(square_next))
+  // A dead snake's 'x' head doesn't point anywhere, so stop once the walk stops moving
+  while ((is_snake(square_next) || is_tail(square_next)) && !(square_next == 'x' && square == 'x'))
   {
     square = square_next;
     pos_x = pos_x_next;
     pos_y = pos_y_next;
+    if (pos_x == saved_x && pos_y == saved_y)
+    {
+      return false;
+    }
+    left -= 1;
+    if (left == 0)
+    {
+      saved_x = pos_x;
+      saved_y = pos_y;
+      power *= 2;
+      left = power;
+    }
     pos_x_next = pos_x_next + incr_x(square_next);
     pos_y_next = pos_y_next + incr_y(square_next);
-    square_next = get_board_at(state, pos_x_next, pos_y_next);
-    // printf("square: %c, square_next: %c(%i, %i)\n", square, square_next, pos_x_next, pos_y_next);
+    square_next = sparse ? get_board_at(state, pos_x_next, pos_y_next) : state->board[pos_y_next][pos_x_next];
+  }
+  snake->head_x = pos_x;
+  snake->head_y = pos_y;
+  return true;
+}
+
+typedef struct heads_job_t
+{
+  game_state_t *state;
+  snake_t *snakes;
+  // The first snake in each chunk whose body loops back on itself, if any
+  size_t *loops;
+} heads_job_t;
+
+static void find_heads(unsigned int chunk, size_t begin, size_t end, void *ctx)
+{
+  heads_job_t *job = (heads_job_t *)ctx;
+  for (size_t i = begin; i < end; i += 1)
+  {
+    snake_t *snake = &job->snakes[i];
+    if (!walk_to_head(job->state, snake))
+    {
+      job->loops[chunk] = i < job->loops[chunk] ? i : job->loops[chunk];
+      snake->live = false;
+      continue;
+    }
+    snake->live = get_board_at(job->state, snake->head_x, snake->head_y) != 'x';
   }
-  state->snakes[snum].head_x = pos_x;
-  state->snakes[snum].head_y = pos_y;
+}
+
+/*
+  Finds the heads of count snakes, in parallel unless the board is sparse. Returns the first snake
+  whose body loops back on itself, or count if there is none; those snakes are left dead.
+*/
+static size_t find_all_heads(game_state_t *state, snake_t *snakes, size_t count)
+{
+  unsigned int num_chunks = state->sparse != NULL ? 1 : parallel_chunks(count, HEADS_PER_CHUNK);
+  heads_job_t job;
+  job.state = state;
+  job.snakes = snakes;
+  job.loops = (size_t *)malloc(num_chunks * sizeof(size_t));
+  for (unsigned int c = 0; c < num_chunks; c += 1)
+  {
+    job.loops[c] = count;
+  }
+  // Each walk only writes its own snake, so heads can be found in parallel
+  STATS_START(STATS_FIND_HEAD);
+  parallel_run(num_chunks, count, find_heads, &job);
+  STATS_STOP_COUNT(STATS_FIND_HEAD, count);
+  size_t first = count;
+  for (unsigned int c = 0; c < num_chunks; c += 1)
+  {
+    first = job.loops[c] < first ? job.loops[c] : first;
+  }
+  free(job.loops);
+  return first;
+}
+
+/*
+  Finds the heads of the snakes whose tails were found while loading, so that a body looping back
+  on itself is caught with the other problems in the file. Reports the first one to errors, at its
+  tail, and returns false.
+*/
+static bool check_snakes(game_state_t *state, const char *filename, FILE *errors)
+{
+  size_t first = find_all_heads(state, state->tail_hints, state->num_tail_hints);
+  if (first == state->num_tail_hints)
+  {
+    return true;
+  }
+  snake_t *snake = &state->tail_hints[first];
+  fprintf(errors, "%s:%u:%u: snake body loops back on itself\n", filename, snake->tail_y + 1, snake->tail_x + 1);
+  return false;
+}
+
+/*
+  Same as load_board, but the rows point straight into a private mapping of the file instead of
+  being copied, so the board takes no memory of its own until it is written to. Files without a
+  final newline or with CRLF line endings can't be used as-is and are loaded with load_board
+  instead, and so is stdin.
+*/
+game_state_t *load_board_mapped(char *filename)
+{
+  if (strcmp(filename, "-") == 0)
+  {
+    return load_board(filename);
+  }
+  STATS_START(STATS_LOAD_BOARD);
+  game_state_t *state = NULL;
+  bool copy = false;
+  board_map_t *map = board_map_open(filename);
+  const char *newline = map != NULL ? (const char *)memchr(map->base, '\n', map->len) : NULL;
+  if (map != NULL && (map->base[map->len - 1] != '\n' || (newline > map->base && newline[-1] == '\r')))
+  {
+    board_map_release(map);
+    copy = true;
+  }
+  else if (map != NULL)
+  {
+    state = parse_board(NULL, filename, map->base, map->len, map, stderr);
+  }
+  STATS_STOP(STATS_LOAD_BOARD);
+  return copy ? load_board(filename) : state;
+}
+
+/* Task 6.1 */
+static void find_head(game_state_t *state, int snum)
+{
+  STATS_START(STATS_FIND_HEAD);
+  walk_to_head(state, &state->snakes[snum]);
+  STATS_STOP(STATS_FIND_HEAD);
   return;
 }
 
+/* Records the tails of a sparse board, in row-major order, by going through its chunks a band of rows at a time. */
+static void scan_sparse_tails(game_state_t *state)
+{
+  board_chunk_t found;
+  memset(&found, 0, sizeof(found));
+  sparse_chunk_t **chunks = sparse_board_sorted_chunks(state->sparse);
+  sparse_chunk_t **band = chunks;
+  while (*band != NULL)
+  {
+    sparse_chunk_t **end = band;
+    while (*end != NULL && (*end)->chunk_y == (*band)->chunk_y)
+    {
+      end += 1;
+    }
+    for (unsigned int row = 0; row < SPARSE_CHUNK; row += 1)
+    {
+      for (sparse_chunk_t **chunk = band; chunk < end; chunk += 1)
+      {
+        for (unsigned int col = 0; col < SPARSE_CHUNK; col += 1)
+        {
+          if (is_tail((*chunk)->cells[row * SPARSE_CHUNK + col]))
+          {
+            add_tail(&found.tails, (*chunk)->chunk_x * SPARSE_CHUNK + col, (*chunk)->chunk_y * SPARSE_CHUNK + row);
+          }
+        }
+      }
+    }
+    band = end;
+  }
+  free(chunks);
+  merge_tails(state, &found, 1);
+}
+
 /* Task 6.2 */
 game_state_t *initialize_snakes(game_state_t *state)
 {
-  state->snakes = (snake_t *)malloc(4 * sizeof(snake_t));
-  for (int i = 0; i < state->y_size; i += 1)
+  STATS_START(STATS_INITIALIZE_SNAKES);
+  // Loaders find the heads of the tails they hand over while checking for loops
+  bool walked = state->tail_hints != NULL;
+  // Boards that didn't come straight from load_board have to be scanned for tails first
+  if (state->tail_hints == NULL && state->sparse != NULL)
+  {
+    scan_sparse_tails(state);
+  }
+  else if (state->tail_hints == NULL)
+  {
+    unsigned int num_chunks = parallel_chunks(state->y_size, rows_per_chunk(state));
+    board_job_t job;
+    job.state = state;
+    job.buf = NULL;
+    job.len = 0;
+    job.last_row = state->y_size - 1;
+    job.chunks = (board_chunk_t *)calloc(num_chunks, sizeof(board_chunk_t));
+    parallel_run(num_chunks, state->y_size, scan_rows, &job);
+    merge_tails(state, job.chunks, num_chunks);
+    free(job.chunks);
+  }
+
+  // The tails are already in row-major order, which is the order snakes are numbered in
+  state->snakes = state->tail_hints;
+  state->num_snakes = state->num_tail_hints;
+  state->tail_hints = NULL;
+  state->num_tail_hints = 0;
+
+  if (!walked)
+  {
+    find_all_heads(state, state->snakes, state->num_snakes);
+  }
+  refresh_live_snakes(state);
+  STATS_STOP(STATS_INITIALIZE_SNAKES);
+  return state;
+}
+
+/* Rebuilds the live-snake list from the snake table, for code that changed which snakes are alive. */
+void refresh_live_snakes(game_state_t *state)
+{
+  size_t size = (state->num_snakes + 1) * sizeof(unsigned int);
+  if (state->arena == NULL)
+  {
+    state->live_snakes = (unsigned int *)realloc(state->live_snakes, size);
+  }
+  else
+  {
+    state->live_snakes = (unsigned int *)state_alloc(state->arena, size);
+  }
+  state->num_live = 0;
+  for (unsigned int i = 0; i < state->num_snakes; i += 1)
+  {
+    if (state->snakes[i].live)
+    {
+      state->live_snakes[state->num_live] = i;
+      state->num_live += 1;
+    }
+  }
+}
+
+/* A state with no cells, no snakes and an empty sparse board of the given size. */
+static game_state_t *new_sparse_state(unsigned int x_size, unsigned int y_size)
+{
+  game_state_t *state = (game_state_t *)calloc(1, sizeof(game_state_t));
+  state->x_size = x_size;
+  state->y_size = y_size;
+  state->sparse = sparse_board_create(x_size, y_size);
+  return state;
+}
+
+/*
+  Builds an empty board of the given size with a wall around it, stored as a sparse board. Only
+  the wall takes memory, so worlds far too large to hold as rows fit. Place snakes and food with
+  set_board_at, then call initialize_snakes.
+*/
+game_state_t *create_sparse_state(unsigned int x_size, unsigned int y_size)
+{
+  game_state_t *state = new_sparse_state(x_size, y_size);
+  for (unsigned int x = 0; x < x_size; x += 1)
+  {
+    set_board_at(state, x, 0, '#');
+    set_board_at(state, x, y_size - 1, '#');
+  }
+  for (unsigned int y = 0; y < y_size; y += 1)
+  {
+    set_board_at(state, 0, y, '#');
+    set_board_at(state, x_size - 1, y, '#');
+  }
+  return state;
+}
+
+/*
+  Same as load_board, but the board is stored sparsely and the file is streamed a row at a time, so
+  memory only grows with the cells that aren't empty, however large the board is.
+*/
+game_state_t *load_board_sparse(char *filename)
+{
+  STATS_START(STATS_LOAD_BOARD);
+  row_reader_t reader;
+  if (!open_rows(&reader, filename))
   {
-    for (int j = 0; j < state->x_size; j += 1)
+    STATS_STOP(STATS_LOAD_BOARD);
+    return NULL;
+  }
+
+  game_state_t *state = new_sparse_state(0, 0);
+  board_chunk_t found;
+  memset(&found, 0, sizeof(found));
+  size_t y = 0;
+  const char *error = NULL;
+  size_t error_col = 0;
+  // Where the last row stops being wall, since only the end of the file tells which row is last
+  size_t last_gap = 0;
+  const char *row;
+  size_t len;
+  while (error == NULL && next_row(&reader, &row, &len))
+  {
+    if (y == 0)
     {
-      char square = get_board_at(state, j, i);
-      if (!is_tail(square))
+      // The first row sets the width of all the others
+      state->x_size = len;
+      error = len == 0 ? "board is empty" : NULL;
+    }
+    error = error != NULL ? error : board_check_row(row, len, state->x_size, y == 0, &error_col);
+    if (error == NULL)
+    {
+      last_gap = board_check_walls(row, len);
+      size_t x = board_next_cell(row, len);
+      while (x < len)
       {
-        continue;
+        if (is_tail(row[x]))
+        {
+          add_tail(&found.tails, x, y);
+        }
+        set_board_at(state, x, y, row[x]);
+        x += 1 + board_next_cell(row + x + 1, len - x - 1);
       }
-      state->snakes[state->num_snakes].live = true;
-      state->snakes[state->num_snakes].tail_x = j;
-      state->snakes[state->num_snakes].tail_y = i;
-      find_head(state, state->num_snakes);
-      // printf("initialize_snakes snake %i head(%i,%i), tail(%i, %i)\n", state->num_snakes, state->snakes[0].head_x, state->snakes[0].head_y, state->snakes[0].tail_x, state->snakes[0].tail_y);
-      state->num_snakes += 1;
+      y += 1;
+    }
+  }
+  if (error == NULL && y == 0 && !reader.failed)
+  {
+    error = "board is empty";
+  }
+  else if (error == NULL && !reader.failed && last_gap < state->x_size)
+  {
+    y -= 1;
+    error = "border is not a wall";
+    error_col = last_gap;
+  }
+  bool failed = reader.failed;
+  const char *name = reader.name;
+  close_rows(&reader);
+
+  if (error != NULL || failed)
+  {
+    if (error != NULL)
+    {
+      fprintf(stderr, "%s:%zu:%zu: %s\n", name, y + 1, error_col + 1, error);
     }
+    free(found.tails.tails);
+    free_state(state);
+    STATS_STOP(STATS_LOAD_BOARD);
+    return NULL;
+  }
+  state->y_size = y;
+  state->sparse->x_size = state->x_size;
+  state->sparse->y_size = state->y_size;
+  merge_tails(state, &found, 1);
+  if (!check_snakes(state, name, stderr))
+  {
+    free_state(state);
+    state = NULL;
   }
+  STATS_STOP(STATS_LOAD_BOARD);
   return state;
 }
+
+/* Upper bound on the arena bytes needed for one state of the given size. */
+size_t state_arena_size(unsigned int x_size, unsigned int y_size, unsigned int num_snakes)
+{
+  // Each allocation may be padded by up to 16 bytes for alignment
+  size_t size = sizeof(game_state_t) + 16;
+  size += y_size * sizeof(char *) + 16;
+  size += (size_t)y_size * (sizeof(board_row_t) + x_size + 2 + 16);
+  // The snake table and live list always have room for at least one entry
+  size += (num_snakes + 1) * sizeof(snake_t) + 16;
+  size += (num_snakes + 1) * sizeof(unsigned int) + 16;
+  return size;
+}
+
+/* Creates a pool of count arenas, each pre-sized to hold one state. */
+state_pool_t *state_pool_create(unsigned int count, unsigned int x_size, unsigned int y_size, unsigned int max_snakes)
+{
+  state_pool_t *pool = (state_pool_t *)malloc(sizeof(state_pool_t));
+  pool->x_size = x_size;
+  pool->y_size = y_size;
+  pool->max_snakes = max_snakes;
+  pool->num_free = count;
+  pool->capacity = count;
+  pool->free_arenas = (arena_t **)malloc(count * sizeof(arena_t *));
+  for (unsigned int i = 0; i < count; i += 1)
+  {
+    pool->free_arenas[i] = arena_create(state_arena_size(x_size, y_size, max_snakes));
+  }
+  return pool;
+}
+
+/* Hands out an empty arena from the pool. If the pool is exhausted, a new arena of the same size is created. */
+arena_t *state_pool_acquire(state_pool_t *pool)
+{
+  if (pool->num_free == 0)
+  {
+    return arena_create(state_arena_size(pool->x_size, pool->y_size, pool->max_snakes));
+  }
+  pool->num_free -= 1;
+  return pool->free_arenas[pool->num_free];
+}
+
+/* Returns an arena to the pool. Any state allocated from it must no longer be used. */
+void state_pool_release(state_pool_t *pool, arena_t *arena)
+{
+  arena_reset(arena);
+  if (pool->num_free == pool->capacity)
+  {
+    pool->capacity = pool->capacity * 2 + 1;
+    pool->free_arenas = (arena_t **)realloc(pool->free_arenas, pool->capacity * sizeof(arena_t *));
+  }
+  pool->free_arenas[pool->num_free] = arena;
+  pool->num_free += 1;
+}
+
+/* Frees the pool and every arena currently in it. */
+void state_pool_destroy(state_pool_t *pool)
+{
+  for (unsigned int i = 0; i < pool->num_free; i += 1)
+  {
+    arena_destroy(pool->free_arenas[i]);
+  }
+  free(pool->free_arenas);
+  free(pool);
+}
@@ -2,7 +2,11 @@
 #define _SNK_STATE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include "arena.h"
+#include "board_map.h"
+#include "sparse_board.h"
 
 typedef struct snake_t {
   unsigned int tail_x;
@@ -13,22 +17,96 @@ typedef struct snake_t {
   bool live;
 } snake_t;
 
+struct game_state_t;
+
+/* Called by set_board_at whenever a cell changes, with the character it held before. */
+typedef void (*board_watcher_t)(struct game_state_t* state, int x, int y, char old_ch, char new_ch, void* ctx);
+
+#define MAX_BOARD_WATCHERS 4
+
+typedef struct board_watch_t {
+  board_watcher_t fn;
+  void* ctx;
+} board_watch_t;
+
 typedef struct game_state_t {
   unsigned int x_size;
   unsigned int y_size;
 
   char **board;
 
+  // Zobrist hash of the board, kept up to date by set_board_at
+  uint64_t hash;
+
   unsigned int num_snakes;
   snake_t* snakes;
+
+  // Indices of the snakes that are still alive, in increasing order. update_state only visits
+  // these and drops snakes from the list as they die, so dead snakes cost nothing per tick. Built
+  // by initialize_snakes; code that edits the snake table directly calls refresh_live_snakes.
+  unsigned int num_live;
+  unsigned int* live_snakes;
+
+  // Tails found by load_board, in row-major order, for initialize_snakes to pick up. Dropped by
+  // the first set_board_at, since the board may no longer match them.
+  unsigned int num_tail_hints;
+  snake_t* tail_hints;
+
+  // Arena the board, rows and snakes were allocated from, or NULL if they came from malloc
+  arena_t* arena;
+
+  // For states from load_board_mapped, the file mapping that unmodified rows point into. Those
+  // rows end at their newline, with no null terminator.
+  board_map_t* map;
+
+  // For states from create_sparse_state and load_board_sparse, the chunked board that holds the
+  // cells instead of board, which is NULL. Only reachable through get_board_at and set_board_at.
+  sparse_board_t* sparse;
+
+  // Callbacks notified of every board change (not inherited by clones)
+  unsigned int num_watchers;
+  board_watch_t watchers[MAX_BOARD_WATCHERS];
 } game_state_t;
 
+/* A fixed set of arenas, each big enough to hold one state of a given size. */
+typedef struct state_pool_t {
+  unsigned int x_size;
+  unsigned int y_size;
+  unsigned int max_snakes;
+
+  unsigned int num_free;
+  unsigned int capacity;
+  arena_t** free_arenas;
+} state_pool_t;
+
 game_state_t* create_default_state();
 void free_state(game_state_t* state);
 void print_board(game_state_t* state, FILE* fp);
 void save_board(game_state_t* state, char* filename);
 void update_state(game_state_t* state, int (*add_food)(game_state_t* state));
 game_state_t * initialize_snakes(game_state_t* state);
+void refresh_live_snakes(game_state_t* state);
 game_state_t* load_board(char* filename);
+game_state_t* load_board_mapped(char* filename);
+game_state_t* load_board_from_memory(const char* name, char* buf, size_t len);
+game_state_t* create_sparse_state(unsigned int x_size, unsigned int y_size);
+game_state_t* load_board_sparse(char* filename);
+
+char get_board_at(game_state_t* state, int x, int y);
+void set_board_at(game_state_t* state, int x, int y, char ch);
+game_state_t* clone_state(game_state_t* state);
+uint64_t board_hash(game_state_t* state);
+bool watch_board(game_state_t* state, board_watcher_t fn, void* ctx);
+void unwatch_board(game_state_t* state, board_watcher_t fn, void* ctx);
+
+game_state_t* create_default_state_in(arena_t* arena);
+game_state_t* load_board_in(arena_t* arena, char* filename);
+game_state_t* load_board_from_memory_in(arena_t* arena, const char* name, char* buf, size_t len, FILE* errors);
+size_t state_arena_size(unsigned int x_size, unsigned int y_size, unsigned int num_snakes);
+
+state_pool_t* state_pool_create(unsigned int count, unsigned int x_size, unsigned int y_size, unsigned int max_snakes);
+arena_t* state_pool_acquire(state_pool_t* pool);
+void state_pool_release(state_pool_t* pool, arena_t* arena);
+void state_pool_destroy(state_pool_t* pool);
 
 #endif
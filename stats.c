@@ -0,0 +1,54 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+#include "stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+uint64_t stats_calls[STATS_NUM_PHASES];
+uint64_t stats_cycles[STATS_NUM_PHASES];
+
+static const char* phase_names[STATS_NUM_PHASES] = {
+  "load_board",
+  "initialize_snakes",
+  "find_head",
+  "next_square",
+  "update_head",
+  "update_tail",
+  "add_food",
+  "food_retries",
+  "print_board",
+  "save_board",
+};
+
+/* Cycle counter on x86, nanoseconds elsewhere. */
+uint64_t stats_now() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+void stats_dump_json(FILE* fp) {
+#ifdef SNK_STATS
+  const char* enabled = "true";
+#else
+  const char* enabled = "false";
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  const char* unit = "tsc";
+#else
+  const char* unit = "ns";
+#endif
+  fprintf(fp, "{\"enabled\": %s, \"unit\": \"%s\", \"phases\": {", enabled, unit);
+  for (int i = 0; i < STATS_NUM_PHASES; i++) {
+    fprintf(fp, "%s\"%s\": {\"calls\": %llu, \"cycles\": %llu}", i == 0 ? "" : ", ", phase_names[i],
+            (unsigned long long) stats_calls[i], (unsigned long long) stats_cycles[i]);
+  }
+  fprintf(fp, "}}\n");
+}
@@ -0,0 +1,49 @@
+#ifndef _SNK_STATS_H
+#define _SNK_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+  Per-phase call counts and cycle totals. Instrumentation is compiled out unless SNK_STATS is
+  defined (make STATS=1), in which case STATS_START/STATS_STOP read the cycle counter around each
+  phase. The counters are plain globals and are only meaningful for single-threaded runs.
+*/
+typedef enum stats_phase_t {
+  STATS_LOAD_BOARD,
+  STATS_INITIALIZE_SNAKES,
+  STATS_FIND_HEAD,
+  STATS_NEXT_SQUARE,
+  STATS_UPDATE_HEAD,
+  STATS_UPDATE_TAIL,
+  STATS_ADD_FOOD,
+  STATS_FOOD_RETRIES,
+  STATS_PRINT_BOARD,
+  STATS_SAVE_BOARD,
+  STATS_NUM_PHASES
+} stats_phase_t;
+
+extern uint64_t stats_calls[STATS_NUM_PHASES];
+extern uint64_t stats_cycles[STATS_NUM_PHASES];
+
+uint64_t stats_now();
+void stats_dump_json(FILE* fp);
+
+#ifdef SNK_STATS
+#define STATS_START(phase) uint64_t _stats_start_##phase = stats_now()
+#define STATS_STOP(phase) STATS_STOP_COUNT(phase, 1)
+// Stops a phase that handled n items at once, so calls still count items
+#define STATS_STOP_COUNT(phase, n)                                 \
+  do {                                                             \
+    stats_calls[phase] += (n);                                     \
+    stats_cycles[phase] += stats_now() - _stats_start_##phase;     \
+  } while (0)
+#define STATS_COUNT(phase, n) (stats_calls[phase] += (n))
+#else
+#define STATS_START(phase) ((void) 0)
+#define STATS_STOP(phase) ((void) 0)
+#define STATS_STOP_COUNT(phase, n) ((void) 0)
+#define STATS_COUNT(phase, n) ((void) 0)
+#endif
+
+#endif
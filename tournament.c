@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "autopilot.h"
+#include "fixed_engine.h"
+#include "parallel.h"
+#include "snake_utils.h"
+#include "state.h"
+
+/*
+  Tournament runner: plays every starting board once per seed and sums up how the snakes did.
+  Games are independent tasks on a work-stealing pool, since some end after a handful of ticks and
+  others run to the limit. Each game draws food and turns from its own seeds instead of the globals
+  in snake_utils.c, so the results don't depend on which thread played which game.
+*/
+
+#define MAX_BOARDS 64
+
+typedef enum policy_t {
+  POLICY_STRAIGHT,
+  POLICY_RANDOM,
+  POLICY_AUTOPILOT
+} policy_t;
+
+static const char* policy_names[] = {"straight", "random", "autopilot"};
+
+typedef struct game_totals_t {
+  unsigned long games;
+  unsigned long ticks;
+  unsigned long shortest;
+  unsigned long longest;
+  unsigned long snakes;
+  // Sum over all snakes of the ticks they were alive for
+  unsigned long snake_ticks;
+  unsigned long food;
+  unsigned long deaths;
+  // Keeps workers' totals on separate cache lines
+  char padding[64];
+} game_totals_t;
+
+typedef struct tournament_t {
+  policy_t policy;
+  unsigned long max_ticks;
+  unsigned long seeds;
+  uint32_t first_seed;
+  unsigned int num_boards;
+  char* filenames[MAX_BOARDS];
+  // A private copy of every board for each worker, so clones never share rows across threads
+  game_state_t** boards;
+  // One entry per worker and board
+  game_totals_t* totals;
+} tournament_t;
+
+// Food seed and food count of the game running on this thread, for game_food
+static __thread uint32_t* food_seed;
+static __thread unsigned long food_eaten;
+
+int game_food(game_state_t* state) {
+  food_eaten += 1;
+  return seeded_food(state, food_seed);
+}
+
+void play_game(unsigned int worker, size_t task, void* ctx) {
+  tournament_t* tournament = ctx;
+  unsigned int board = task / tournament->seeds;
+  uint32_t game_seed = tournament->first_seed + task % tournament->seeds;
+  uint32_t game_food_seed = game_seed;
+  uint32_t turn_seed = game_seed ^ 0x9E3779B9;
+  food_seed = &game_food_seed;
+  food_eaten = 0;
+
+  game_state_t* state = clone_state(tournament->boards[worker * tournament->num_boards + board]);
+  autopilot_t* autopilot = tournament->policy == POLICY_AUTOPILOT ? autopilot_create(state) : NULL;
+  update_fn_t update = fixed_engine_for(state);
+  unsigned long snake_ticks = 0;
+  unsigned long tick;
+  for (tick = 0; tick < tournament->max_ticks; tick++) {
+    if (state->num_live == 0) {
+      break;
+    }
+    snake_ticks += state->num_live;
+
+    if (autopilot != NULL) {
+      autopilot_steer_all(state, autopilot);
+    } else if (tournament->policy == POLICY_RANDOM && tick % 6 == 0) {
+      for (unsigned int j = 0; j < state->num_live; j++) {
+        seeded_turn(state, state->live_snakes[j], &turn_seed);
+      }
+    }
+    update(state, game_food);
+  }
+
+  game_totals_t* totals = &tournament->totals[worker * tournament->num_boards + board];
+  if (totals->games == 0 || tick < totals->shortest) {
+    totals->shortest = tick;
+  }
+  if (tick > totals->longest) {
+    totals->longest = tick;
+  }
+  totals->games += 1;
+  totals->ticks += tick;
+  totals->snakes += state->num_snakes;
+  totals->snake_ticks += snake_ticks;
+  totals->food += food_eaten;
+  totals->deaths += state->num_snakes - state->num_live;
+
+  if (autopilot != NULL) {
+    autopilot_destroy(autopilot);
+  }
+  free_state(state);
+}
+
+void add_totals(game_totals_t* sum, game_totals_t* totals) {
+  if (totals->games == 0) {
+    return;
+  }
+  if (sum->games == 0 || totals->shortest < sum->shortest) {
+    sum->shortest = totals->shortest;
+  }
+  if (totals->longest > sum->longest) {
+    sum->longest = totals->longest;
+  }
+  sum->games += totals->games;
+  sum->ticks += totals->ticks;
+  sum->snakes += totals->snakes;
+  sum->snake_ticks += totals->snake_ticks;
+  sum->food += totals->food;
+  sum->deaths += totals->deaths;
+}
+
+void report(const char* label, game_totals_t* totals) {
+  double games = totals->games;
+  printf("%s: %lu games\n", label, totals->games);
+  printf("  %-16s %12.1f mean %10lu min %10lu max\n", "ticks per game", totals->ticks / games, totals->shortest,
+         totals->longest);
+  printf("  %-16s %12.1f mean\n", "ticks survived", totals->snakes == 0 ? 0.0 : (double) totals->snake_ticks / totals->snakes);
+  printf("  %-16s %12.2f per game %10lu total\n", "food eaten", totals->food / games, totals->food);
+  printf("  %-16s %12.2f per game %10lu total (%.1f%% of snakes)\n", "deaths", totals->deaths / games, totals->deaths,
+         totals->snakes == 0 ? 0.0 : 100.0 * totals->deaths / totals->snakes);
+}
+
+game_state_t* load_start(char* filename) {
+  if (filename == NULL) {
+    return create_default_state();
+  }
+  game_state_t* state = load_board(filename);
+  return state == NULL ? NULL : initialize_snakes(state);
+}
+
+int main(int argc, char* argv[]) {
+  tournament_t tournament;
+  tournament.policy = POLICY_RANDOM;
+  tournament.max_ticks = 1000;
+  tournament.seeds = 1000;
+  tournament.first_seed = 1;
+  tournament.num_boards = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (i < argc - 1) {
+      char* value = argv[i + 1];
+      bool matched = true;
+      if (strcmp(argv[i], "-i") == 0 && tournament.num_boards < MAX_BOARDS) {
+        tournament.filenames[tournament.num_boards] = value;
+        tournament.num_boards += 1;
+      } else if (strcmp(argv[i], "-g") == 0) {
+        tournament.seeds = strtoul(value, NULL, 10);
+      } else if (strcmp(argv[i], "-n") == 0) {
+        tournament.max_ticks = strtoul(value, NULL, 10);
+      } else if (strcmp(argv[i], "-s") == 0) {
+        tournament.first_seed = strtoul(value, NULL, 10);
+      } else if (strcmp(argv[i], "-j") == 0) {
+        parallel_set_threads(strtoul(value, NULL, 10));
+      } else if (strcmp(argv[i], "-P") == 0) {
+        matched = false;
+        for (int p = 0; p < 3; p++) {
+          if (strcmp(value, policy_names[p]) == 0) {
+            tournament.policy = p;
+            matched = true;
+          }
+        }
+      } else {
+        matched = false;
+      }
+      if (matched) {
+        i++;
+        continue;
+      }
+    }
+    fprintf(stderr,
+            "Usage: %s [-i filename]... [-g seeds per board] [-n max ticks] [-s first seed] [-j threads]\n"
+            "       [-P straight|random|autopilot]\n",
+            argv[0]);
+    return 1;
+  }
+  if (tournament.num_boards == 0) {
+    tournament.filenames[0] = NULL;
+    tournament.num_boards = 1;
+  }
+  if (tournament.seeds == 0) {
+    fprintf(stderr, "Need at least one seed per board\n");
+    return 1;
+  }
+
+  size_t games = (size_t) tournament.num_boards * tournament.seeds;
+  unsigned int workers = parallel_workers(games);
+  tournament.boards = malloc((size_t) workers * tournament.num_boards * sizeof(game_state_t*));
+  tournament.totals = calloc((size_t) workers * tournament.num_boards, sizeof(game_totals_t));
+  for (unsigned int w = 0; w < workers; w++) {
+    for (unsigned int b = 0; b < tournament.num_boards; b++) {
+      game_state_t* state = load_start(tournament.filenames[b]);
+      if (state == NULL) {
+        return 1;
+      }
+      tournament.boards[w * tournament.num_boards + b] = state;
+    }
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  parallel_steal(games, play_game, &tournament);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  game_totals_t overall;
+  memset(&overall, 0, sizeof(overall));
+  for (unsigned int b = 0; b < tournament.num_boards; b++) {
+    game_totals_t board;
+    memset(&board, 0, sizeof(board));
+    for (unsigned int w = 0; w < workers; w++) {
+      add_totals(&board, &tournament.totals[w * tournament.num_boards + b]);
+    }
+    if (tournament.num_boards > 1) {
+      report(tournament.filenames[b] == NULL ? "default board" : tournament.filenames[b], &board);
+    }
+    add_totals(&overall, &board);
+  }
+  report("all boards", &overall);
+  printf("policy %s, seeds %u to %lu, up to %lu ticks\n", policy_names[tournament.policy], tournament.first_seed,
+         (unsigned long) tournament.first_seed + tournament.seeds - 1, tournament.max_ticks);
+  printf("%.3f s on %u threads: %.1f games/s, %.0f ticks/s\n", seconds, workers, overall.games / seconds,
+         overall.ticks / seconds);
+
+  for (size_t i = 0; i < (size_t) workers * tournament.num_boards; i++) {
+    free_state(tournament.boards[i]);
+  }
+  free(tournament.boards);
+  free(tournament.totals);
+  return 0;
+}
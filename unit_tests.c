@@ -1,10 +1,28 @@
+// For popen, dup2 and socketpair
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 // Necessary due to static functions in state.c
 #include "state.c"
+#include "autopilot.h"
+#include "board_check.h"
+#include "checkpoint.h"
+#include "components.h"
+#include "daemon.h"
+#include "fixed_engine.h"
+#include "frame_ring.h"
+#include "history.h"
+#include "parallel.h"
+#include "replay.h"
+#include "sim.h"
 
 char* COLOR_GREEN = "";
 char* COLOR_RESET = "";
@@ -68,6 +86,14 @@ bool assert_state_equals(game_state_t* expected, game_state_t* actual) {
     }
   }
 
+  // Check that the incrementally maintained hashes agree with the boards
+  if (!assert_true("board hash is up to date", actual->hash == board_hash(actual))) {
+    return false;
+  }
+  if (!assert_true("board hashes are equal", expected->hash == actual->hash)) {
+    return false;
+  }
+
   // Check that num_snakes are equal
   if (!assert_equals_int("number of snakes", expected->num_snakes, actual->num_snakes)) {
     return false;
@@ -1229,85 +1255,2040 @@ bool test_initialize_snakes() {
   return true;
 }
 
-void init_colors() {
-  if (getenv("NO_COLOR") != NULL) {
-    return;
+bool test_arena_state_board_1() {
+  // a state built in an arena should match one built with malloc
+  game_state_t* expected = create_default_state();
+  arena_t* arena = arena_create(state_arena_size(14, 10, 1));
+  game_state_t* actual = create_default_state_in(arena);
+
+  if (!assert_state_equals(expected, actual)) {
+    return false;
   }
 
-  char* term = getenv("TERM");
-  if (term == NULL || strstr(term, "xterm") == NULL) {
-    return;
+  // free_state is a no-op for arena states, and the arena can be reset and reused
+  free_state(actual);
+  arena_reset(arena);
+  actual = create_default_state_in(arena);
+  if (!assert_true("arena reused its first block", arena->first->next == NULL)) {
+    return false;
   }
+  bool result = assert_state_equals(expected, actual);
+  arena_destroy(arena);
+  free_state(expected);
+  return result;
+}
 
-  COLOR_GREEN = "\033[0;32m";
-  COLOR_RESET = "\033[0m";
+bool test_arena_state_board_2() {
+  // states loaded from a pool arena should match states loaded with malloc
+  game_state_t* expected = load_board("tests/6-small-in.snk");
+  initialize_snakes(expected);
+
+  state_pool_t* pool = state_pool_create(2, 5, 5, 1);
+  for (int i = 0; i < 3; i++) {
+    arena_t* arena = state_pool_acquire(pool);
+    game_state_t* actual = load_board_in(arena, "tests/6-small-in.snk");
+    initialize_snakes(actual);
+    for (int y = 0; y < 5; y++) {
+      if (!assert_true("pool state row matches", strcmp(expected->board[y], actual->board[y]) == 0)) {
+        return false;
+      }
+    }
+    if (!assert_equals_int("number of snakes", expected->num_snakes, actual->num_snakes)) {
+      return false;
+    }
+    if (!assert_equals_int("x-coordinate of snake head", expected->snakes->head_x, actual->snakes->head_x)) {
+      return false;
+    }
+    if (!assert_true("pool arena did not grow", arena->first->next == NULL)) {
+      return false;
+    }
+    state_pool_release(pool, arena);
+  }
+  state_pool_destroy(pool);
+  free_state(expected);
+  return true;
 }
 
-bool test_and_print(char* label, bool (*run_test)()) {
-  printf("\nTesting %s...\n", label);
-  bool result = run_test();
-  if (result) {
-    printf("%sAll %s tests passed!%s\n", COLOR_GREEN, label, COLOR_RESET);
-  } else {
-    printf("Not all %s tests passed.\n", label);
+bool test_arena_state() {
+  if (!test_arena_state_board_1()) {
+    printf("%s\n", "test_arena_state_board_1 failed.");
+    return false;
   }
-  return result;
+
+  if (!test_arena_state_board_2()) {
+    printf("%s\n", "test_arena_state_board_2 failed. Check tests/6-small-in.snk for a diagram of the board.");
+    return false;
+  }
+
+  return true;
 }
 
-/*
-  Feel free to comment out tests.
-*/
-int main(int argc, char* argv[]) {
-  bool MEMCHECK_MODE = false;
+bool test_clone_state_board_1() {
+  /*
+  Board 1 (default), after one update of the clone:
+  ##############        ##############
+  #            #        #            #
+  #        *   #        #        *   #
+  #            #        #            #
+  #   d>       # -----> #    d>      #
+  #            #        #            #
+  #            #        #            #
+  #            #        #            #
+  #            #        #            #
+  ##############        ##############
+  */
 
-  // Parse arguments
-  for (int i = 1; i < argc; i++) {
-    if (strcmp(argv[i], "-m") == 0) {
-      MEMCHECK_MODE = true;
-      continue;
+  // set up expected boards
+  game_state_t* expected_original = create_default_state();
+  game_state_t* expected_clone = create_default_state();
+  set_board_at(expected_clone, 4, 4, ' ');
+  set_board_at(expected_clone, 5, 4, 'd');
+  set_board_at(expected_clone, 6, 4, '>');
+  expected_clone->snakes->head_x = 6;
+  expected_clone->snakes->tail_x = 5;
+  save_board(expected_clone, "unit-test-ref.snk");
+
+  // set up actual boards
+  game_state_t* original = create_default_state();
+  game_state_t* clone = clone_state(original);
+  update_state(clone, corner_food);
+  save_board(clone, "unit-test-out.snk");
+
+  // only the row the clone wrote to should have been copied
+  for (int y = 0; y < 10; y++) {
+    bool shared = original->board[y] == clone->board[y];
+    if (!assert_true("untouched rows are shared", shared == (y != 4))) {
+      return false;
     }
-    fprintf(stderr, "Usage: %s [-m]\n", argv[0]);
-    return 1;
   }
 
-  init_colors();
+  if (!assert_state_equals(expected_clone, clone)) {
+    return false;
+  }
 
-  printf("%s\n", "Reminder: These tests are not comprehensive, and passing them does not guarantee that your implementation is working.");
+  // writes to the clone must not show up in the original
+  if (!assert_state_equals(expected_original, original)) {
+    return false;
+  }
 
-  if (MEMCHECK_MODE) {
-    printf("\nTesting free_state...\n");
-    if (!test_free_state()) {
-      return 0;
-    }
-  } else {
-    if (!test_and_print("create_default_state", test_create_default_state)) {
-      return 0;
-    }
-    if (!test_and_print("print_board", test_print_board)) {
-      return 0;
-    }
-    if (!test_and_print("helpers", test_helpers)) {
-      return 0;
+  // writes to the original must not show up in the clone either
+  set_board_at(original, 1, 1, '*');
+  if (!assert_map_equals(clone, 1, 1, ' ')) {
+    return false;
+  }
+
+  free_state(original);
+  if (!assert_state_equals(expected_clone, clone)) {
+    return false;
+  }
+  free_state(clone);
+  free_state(expected_original);
+  free_state(expected_clone);
+  return true;
+}
+
+bool test_clone_state() {
+  if (!test_clone_state_board_1()) {
+    printf("%s\n", "test_clone_state_board_1 failed. Check unit-test-out.snk and unit-test-ref.snk.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_history_board_1() {
+  // play the default board into the wall, then rewind every tick
+  game_state_t* expected = create_default_state();
+  game_state_t* actual = create_default_state();
+  history_t* history = history_create(actual, 1024);
+  uint32_t start_seed = seed;
+
+  unsigned int timestep = 0;
+  for (; timestep < 10; timestep++) {
+    history_begin_tick(history, actual, timestep);
+    update_state(actual, deterministic_food);
+    history_end_tick(history, actual);
+  }
+  redirect_snake(actual, 'w');
+  save_board(actual, "unit-test-in.snk");
+
+  while (history_rewind(history, actual, &timestep)) {
+  }
+  save_board(actual, "unit-test-out.snk");
+
+  if (!assert_equals_int("rewound timestep", 0, timestep)) {
+    return false;
+  }
+  if (!assert_true("food seed was restored", seed == start_seed)) {
+    return false;
+  }
+  bool result = assert_state_equals(expected, actual);
+  history_destroy(history, actual);
+  return result;
+}
+
+bool test_history_board_2() {
+  // a small buffer keeps only the most recent ticks
+  game_state_t* expected = create_default_state();
+  game_state_t* actual = create_default_state();
+  history_t* history = history_create(actual, 8);
+
+  unsigned int timestep = 0;
+  for (; timestep < 5; timestep++) {
+    if (timestep == 4) {
+      for (int y = 0; y < 10; y++) {
+        for (int x = 0; x < 14; x++) {
+          set_board_at(expected, x, y, get_board_at(actual, x, y));
+        }
+      }
+      memcpy(expected->snakes, actual->snakes, sizeof(snake_t));
     }
-    if (!test_and_print("next_square", test_next_square)) {
-      return 0;
+    history_begin_tick(history, actual, timestep);
+    update_state(actual, deterministic_food);
+    history_end_tick(history, actual);
+  }
+
+  // each tick takes a marker, three cells and a snake, so only one fits
+  if (!assert_true("rewound the last tick", history_rewind(history, actual, &timestep))) {
+    return false;
+  }
+  if (!assert_true("older ticks were dropped", !history_rewind(history, actual, &timestep))) {
+    return false;
+  }
+  if (!assert_equals_int("rewound timestep", 4, timestep)) {
+    return false;
+  }
+  save_board(actual, "unit-test-out.snk");
+  bool result = assert_state_equals(expected, actual);
+  history_destroy(history, actual);
+  return result;
+}
+
+bool test_history() {
+  if (!test_history_board_1()) {
+    printf("%s\n", "test_history_board_1 failed. Check unit-test-in.snk and unit-test-out.snk.");
+    return false;
+  }
+
+  if (!test_history_board_2()) {
+    printf("%s\n", "test_history_board_2 failed. Check unit-test-out.snk.");
+    return false;
+  }
+
+  return true;
+}
+
+/* Turns snake 0 clockwise whenever it is about to hit a wall, so it circles the board forever. */
+void steer_along_walls(game_state_t* state, void* ctx) {
+  char* clockwise = ">v<^";
+  if (next_square(state, 0) == '#') {
+    char head = get_board_at(state, state->snakes->head_x, state->snakes->head_y);
+    set_board_at(state, state->snakes->head_x, state->snakes->head_y, clockwise[(strchr(clockwise, head) - clockwise + 1) % 4]);
+  }
+}
+
+bool test_simulate_board_1() {
+  // a snake circling just inside the walls repeats every 2 * (11 + 7) = 36 ticks
+  game_state_t* expected = create_default_state();
+  game_state_t* actual = create_default_state();
+  set_board_at(expected, 9, 2, ' ');
+  set_board_at(actual, 9, 2, ' ');
+
+  sim_result_t result;
+  simulate(expected, corner_food, steer_along_walls, NULL, 1000003, false, &result);
+  save_board(expected, "unit-test-ref.snk");
+  if (!assert_equals_int("ticks run without cycle detection", 1000003, result.ticks_run)) {
+    return false;
+  }
+
+  simulate(actual, corner_food, steer_along_walls, NULL, 1000003, true, &result);
+  save_board(actual, "unit-test-out.snk");
+  if (!assert_equals_int("cycle length", 36, result.cycle_length)) {
+    return false;
+  }
+  if (!assert_true("most ticks were skipped", result.ticks_run < 200)) {
+    return false;
+  }
+  return assert_state_equals(expected, actual);
+}
+
+bool test_simulate_board_2() {
+  // once the only snake hits the wall there is nothing left to simulate
+  game_state_t* actual = create_default_state();
+  sim_result_t result;
+  simulate(actual, corner_food, NULL, NULL, 1000, true, &result);
+
+  if (!assert_true("all snakes are dead", result.all_dead)) {
+    return false;
+  }
+  if (!assert_equals_int("ticks run", 8, result.ticks_run)) {
+    return false;
+  }
+  return assert_map_equals(actual, 12, 4, 'x');
+}
+
+bool test_simulate() {
+  if (!test_simulate_board_1()) {
+    printf("%s\n", "test_simulate_board_1 failed. Check unit-test-out.snk and unit-test-ref.snk.");
+    return false;
+  }
+
+  if (!test_simulate_board_2()) {
+    printf("%s\n", "test_simulate_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool assert_loads_match(game_state_t* expected, game_state_t* actual) {
+  for (unsigned int y = 0; y < expected->y_size; y++) {
+    if (memcmp(expected->board[y], actual->board[y], expected->x_size + 1) != 0) {
+      printf("Assertion error: row %u differs\n", y);
+      return false;
     }
-    if (!test_and_print("update_head", test_update_head)) {
-      return 0;
+  }
+  if (!assert_true("board hashes are equal", expected->hash == actual->hash)) {
+    return false;
+  }
+  if (!assert_equals_int("number of snakes", expected->num_snakes, actual->num_snakes)) {
+    return false;
+  }
+  for (unsigned int i = 0; i < expected->num_snakes; i++) {
+    snake_t* e = &expected->snakes[i];
+    snake_t* a = &actual->snakes[i];
+    if (e->tail_x != a->tail_x || e->tail_y != a->tail_y || e->head_x != a->head_x || e->head_y != a->head_y
+        || e->live != a->live) {
+      printf("Assertion error: snake %u differs\n", i);
+      return false;
     }
-    if (!test_and_print("update_tail", test_update_tail)) {
-      return 0;
+  }
+  return true;
+}
+
+bool test_parallel_load_board_1() {
+  // a board big enough to be split across threads, with snakes that cross chunk boundaries
+  unsigned int width = 1500;
+  unsigned int height = 2100;
+  FILE* f = fopen("unit-test-in.snk", "w");
+  for (unsigned int y = 0; y < height; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      char c = ' ';
+      if (x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+        c = '#';
+      } else if (x % 10 == 5 && y % 400 >= 10 && y % 400 < 50) {
+        // vertical snakes, 40 long, moving down; every third one is dead
+        c = y % 400 == 10 ? 's' : y % 400 < 49 || x % 30 != 5 ? 'v' : 'x';
+      } else if (y % 7 == 3 && x % 50 >= 20 && x % 50 < 24) {
+        c = x % 50 == 20 ? 'd' : '>';
+      } else if ((x * 31 + y * 17) % 97 == 0) {
+        c = '*';
+      }
+      fputc(c, f);
     }
-    if (!test_and_print("update_state", test_update_state)) {
-      return 0;
+    fputc('\n', f);
+  }
+  fclose(f);
+
+  parallel_set_threads(1);
+  game_state_t* expected = initialize_snakes(load_board("unit-test-in.snk"));
+  parallel_set_threads(4);
+  game_state_t* actual = initialize_snakes(load_board("unit-test-in.snk"));
+  parallel_set_threads(0);
+
+  if (!assert_true("board loaded", expected != NULL && actual != NULL)) {
+    return false;
+  }
+  if (!assert_equals_int("number of snakes", 150 * 6 + 30 * 300, expected->num_snakes)) {
+    return false;
+  }
+  if (!assert_equals_int("head of the first snake", 23, expected->snakes[0].head_x)) {
+    return false;
+  }
+  if (!assert_true("hash matches board", actual->hash == board_hash(actual))) {
+    return false;
+  }
+  bool result = assert_loads_match(expected, actual);
+  free_state(expected);
+  free_state(actual);
+  return result;
+}
+
+bool test_parallel_load_board_2() {
+  // rows of the wrong length and unknown characters are rejected; a missing final newline is not
+  char* boards[] = {"#####\n#   #\n#####\n", "#####\n#  #\n#####\n", "#####\n#   ##\n#####\n", "#####\n# ? #\n#####\n",
+                    "#####\n#   #\n#####"};
+  bool valid[] = {true, false, false, false, true};
+  for (int i = 0; i < 5; i++) {
+    FILE* f = fopen("unit-test-in.snk", "w");
+    fputs(boards[i], f);
+    fclose(f);
+    game_state_t* state = load_board("unit-test-in.snk");
+    if (!assert_true("board is accepted only if it is valid", (state != NULL) == valid[i])) {
+      printf("Board %d:\n%s\n", i, boards[i]);
+      return false;
     }
-    if (!test_and_print("load_board", test_load_board)) {
-      return 0;
+    if (state != NULL) {
+      if (!assert_true("last row ends in a newline", strcmp(state->board[2], "#####\n") == 0)) {
+        return false;
+      }
+      free_state(state);
     }
-    if (!test_and_print("find_head", test_find_head)) {
-      return 0;
+  }
+  return true;
+}
+
+bool test_parallel_load() {
+  if (!test_parallel_load_board_1()) {
+    printf("%s\n", "test_parallel_load_board_1 failed. Check unit-test-in.snk.");
+    return false;
+  }
+
+  if (!test_parallel_load_board_2()) {
+    printf("%s\n", "test_parallel_load_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_mapped_board_1() {
+  // a mapped board matches a copied one, and writes never reach the file
+  game_state_t* expected = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  game_state_t* actual = load_board_mapped("tests/9-everything-in.snk");
+  if (!assert_true("board mapped", actual != NULL && actual->map != NULL)) {
+    return false;
+  }
+  initialize_snakes(actual);
+  if (!assert_true("first row points into the mapping", actual->board[0] == actual->map->base)) {
+    return false;
+  }
+  for (unsigned int y = 0; y < expected->y_size; y++) {
+    if (!assert_true("mapped row matches", memcmp(expected->board[y], actual->board[y], expected->x_size + 1) == 0)) {
+      return false;
     }
-    if (!test_and_print("initialize_snakes", test_initialize_snakes)) {
+  }
+
+  // both updates have to see the same food
+  uint64_t initial_hash = actual->hash;
+  uint32_t initial_seed = seed;
+  update_state(expected, deterministic_food);
+  seed = initial_seed;
+  update_state(actual, deterministic_food);
+  save_board(actual, "unit-test-out.snk");
+  save_board(expected, "unit-test-ref.snk");
+  bool result = assert_loads_match(expected, actual);
+
+  game_state_t* reloaded = load_board("tests/9-everything-in.snk");
+  if (!assert_true("file is unchanged", reloaded->hash == initial_hash && initial_hash != actual->hash)) {
+    return false;
+  }
+  free_state(reloaded);
+  free_state(expected);
+  free_state(actual);
+  return result;
+}
+
+bool test_mapped_board_2() {
+  // a clone of a mapped board gets its own copy of each row it writes to
+  game_state_t* original = load_board_mapped("tests/1-simple-in.snk");
+  initialize_snakes(original);
+  game_state_t* clone = clone_state(original);
+  if (!assert_equals_int("mapping references", 2, original->map->refs)) {
+    return false;
+  }
+  update_state(clone, deterministic_food);
+  if (!assert_map_equals(original, 5, 4, '>') || !assert_map_equals(original, 6, 4, ' ')
+      || !assert_map_equals(clone, 6, 4, '>')) {
+    return false;
+  }
+  if (!assert_true("written row was copied", clone->board[4] != original->board[4])) {
+    return false;
+  }
+  if (!assert_true("other rows are still shared", clone->board[3] == original->board[3])) {
+    return false;
+  }
+  free_state(clone);
+
+  // once the clone is gone, the original writes into the mapping directly
+  char* row = original->board[4];
+  set_board_at(original, 6, 4, '*');
+  bool result = assert_true("row written in place", original->board[4] == row)
+                && assert_true("hash matches board", original->hash == board_hash(original));
+  free_state(original);
+  return result;
+}
+
+bool test_mapped_board() {
+  if (!test_mapped_board_1()) {
+    printf("%s\n", "test_mapped_board_1 failed. Check unit-test-out.snk and unit-test-ref.snk.");
+    return false;
+  }
+
+  if (!test_mapped_board_2()) {
+    printf("%s\n", "test_mapped_board_2 failed. Check tests/1-simple-in.snk for a diagram of the board.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_stream_load_board_1() {
+  // CRLF line endings load the same as LF, copied, mapped or sparse; a stray carriage return does not
+  FILE* in = fopen("tests/9-everything-in.snk", "r");
+  FILE* out = fopen("unit-test-in.snk", "w");
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    if (c == '\n') {
+      fputc('\r', out);
+    }
+    fputc(c, out);
+  }
+  fclose(in);
+  fclose(out);
+
+  game_state_t* expected = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  game_state_t* copied = initialize_snakes(load_board("unit-test-in.snk"));
+  game_state_t* mapped = initialize_snakes(load_board_mapped("unit-test-in.snk"));
+  game_state_t* sparse = initialize_snakes(load_board_sparse("unit-test-in.snk"));
+  if (!assert_true("boards loaded", copied != NULL && mapped != NULL && sparse != NULL)) {
+    return false;
+  }
+  bool result = assert_loads_match(expected, copied) && assert_loads_match(expected, mapped);
+  result = result && assert_true("sparse hash", sparse->hash == expected->hash);
+  result = result && assert_equals_int("sparse snakes", expected->num_snakes, sparse->num_snakes);
+  free_state(expected);
+  free_state(copied);
+  free_state(mapped);
+  free_state(sparse);
+
+  out = fopen("unit-test-in.snk", "w");
+  fputs("#####\r\n# \r #\r\n#####\r\n", out);
+  fclose(out);
+  return result && assert_true("carriage return inside a row is rejected", load_board("unit-test-in.snk") == NULL);
+}
+
+bool test_stream_load_board_2() {
+  // rows much longer than a read block, and no final newline
+  unsigned int width = 5 * 1000 * 1000 / 2;
+  FILE* f = fopen("unit-test-in.snk", "w");
+  for (unsigned int y = 0; y < 3; y++) {
+    for (unsigned int x = 0; x < width; x++) {
+      fputc(y != 1 || x == 0 || x == width - 1 ? '#' : x == width / 2 ? '*' : ' ', f);
+    }
+    if (y < 2) {
+      fputc('\n', f);
+    }
+  }
+  fclose(f);
+
+  game_state_t* state = load_board("unit-test-in.snk");
+  if (!assert_true("board loaded", state != NULL)) {
+    return false;
+  }
+  bool result = assert_equals_int("width", width, state->x_size) && assert_equals_int("height", 3, state->y_size);
+  result = result && assert_map_equals(state, width - 1, 1, '#') && assert_map_equals(state, width / 2, 1, '*');
+  result = result && assert_true("last row ends in a newline", state->board[2][width] == '\n');
+  result = result && assert_true("hash matches board", state->hash == board_hash(state));
+  free_state(state);
+  return result;
+}
+
+bool test_stream_load_board_3() {
+  // "-" reads the board from stdin, which can be a pipe
+  game_state_t* expected = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  game_state_t* actual[2];
+  int saved_stdin = dup(STDIN_FILENO);
+  for (int i = 0; i < 2; i++) {
+    FILE* source = popen("cat tests/9-everything-in.snk", "r");
+    dup2(fileno(source), STDIN_FILENO);
+    clearerr(stdin);
+    actual[i] = initialize_snakes(i == 0 ? load_board("-") : load_board_sparse("-"));
+    pclose(source);
+  }
+  dup2(saved_stdin, STDIN_FILENO);
+  close(saved_stdin);
+  clearerr(stdin);
+
+  if (!assert_true("boards loaded", actual[0] != NULL && actual[1] != NULL)) {
+    return false;
+  }
+  bool result = assert_loads_match(expected, actual[0]);
+  result = result && assert_true("sparse hash", actual[1]->hash == expected->hash);
+  result = result && assert_equals_int("sparse snakes", expected->num_snakes, actual[1]->num_snakes);
+  free_state(expected);
+  free_state(actual[0]);
+  free_state(actual[1]);
+  return result;
+}
+
+bool test_stream_load() {
+  if (!test_stream_load_board_1()) {
+    printf("%s\n", "test_stream_load_board_1 failed. Check unit-test-in.snk.");
+    return false;
+  }
+
+  if (!test_stream_load_board_2()) {
+    printf("%s\n", "test_stream_load_board_2 failed.");
+    return false;
+  }
+
+  if (!test_stream_load_board_3()) {
+    printf("%s\n", "test_stream_load_board_3 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_checkpoint_board_1() {
+  // the file holds the last board queued, even though the game moved on while it was written
+  game_state_t* state = create_default_state();
+  checkpoint_t* checkpoint = checkpoint_create("unit-test-out.snk");
+  checkpoint_save(checkpoint, state);
+  update_state(state, corner_food);
+  update_state(state, corner_food);
+  checkpoint_save(checkpoint, state);
+  game_state_t* expected = clone_state(state);
+  update_state(state, corner_food);
+  if (!assert_equals_int("checkpoint errors", 0, checkpoint_destroy(checkpoint))) {
+    return false;
+  }
+
+  game_state_t* actual = load_board("unit-test-out.snk");
+  if (!assert_true("checkpoint loaded", actual != NULL)) {
+    return false;
+  }
+  save_board(expected, "unit-test-ref.snk");
+  bool result = assert_true("checkpoint matches the queued board", actual->hash == expected->hash);
+  for (unsigned int y = 0; result && y < expected->y_size; y++) {
+    result = assert_true("checkpoint row matches", memcmp(expected->board[y], actual->board[y], expected->x_size + 1) == 0);
+  }
+  result = result && assert_map_equals(state, 8, 4, '>');
+  free_state(actual);
+  free_state(expected);
+  free_state(state);
+  return result;
+}
+
+bool test_checkpoint_board_2() {
+  // a sparse board has no rows to write, so it is refused instead of queued
+  game_state_t* state = create_default_state();
+  save_board(state, "unit-test-in.snk");
+  free_state(state);
+  state = initialize_snakes(load_board_sparse("unit-test-in.snk"));
+  if (!assert_true("board loaded", state != NULL)) {
+    return false;
+  }
+  remove("unit-test-out.snk");
+  checkpoint_t* checkpoint = checkpoint_create("unit-test-out.snk");
+  checkpoint_save(checkpoint, state);
+  bool result = assert_equals_int("saved", 0, checkpoint->saved);
+  result = assert_equals_int("checkpoint error", EINVAL, checkpoint_destroy(checkpoint)) && result;
+  result = result && assert_true("nothing written", access("unit-test-out.snk", F_OK) != 0);
+  free_state(state);
+  return result;
+}
+
+bool test_checkpoint() {
+  if (!test_checkpoint_board_1()) {
+    printf("%s\n", "test_checkpoint_board_1 failed. Check unit-test-out.snk and unit-test-ref.snk.");
+    return false;
+  }
+
+  if (!test_checkpoint_board_2()) {
+    printf("%s\n", "test_checkpoint_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_frame_ring_board_1() {
+  // readers always get the newest frame, even after the writer has lapped the ring
+  game_state_t* state = create_default_state();
+  frame_ring_t* writer = frame_ring_create("/snake-unit-tests", state->x_size, state->y_size, 4);
+  if (!assert_true("ring created", writer != NULL)) {
+    return false;
+  }
+  frame_ring_t* reader = frame_ring_attach("/snake-unit-tests");
+  if (!assert_true("ring attached", reader != NULL)) {
+    return false;
+  }
+
+  frame_t frame;
+  frame.cells = NULL;
+  if (!assert_true("nothing to read before the first frame", !frame_ring_read(reader, &frame))) {
+    return false;
+  }
+  for (int i = 0; i < 6; i++) {
+    frame_ring_publish(writer, state, i * 10);
+    update_state(state, corner_food);
+  }
+  bool result = assert_true("frame read", frame_ring_read(reader, &frame))
+                && assert_equals_int("frame number", 5, frame.frame)
+                && assert_equals_int("frame timestep", 50, frame.timestep)
+                && assert_equals_char("snake head in frame", '>', frame.cells[4 * 15 + 10])
+                && assert_equals_char("snake tail in frame", 'd', frame.cells[4 * 15 + 9]);
+
+  result = result && assert_true("ring open", !frame_ring_closed(reader));
+  frame_ring_destroy(writer);
+  result = result && assert_true("ring closed", frame_ring_closed(reader));
+  free(frame.cells);
+  frame_ring_destroy(reader);
+  free_state(state);
+  return result;
+}
+
+bool test_frame_ring_board_2() {
+  // a sparse board is published cell by cell, and reads back the same as its rows would
+  game_state_t* expected = create_default_state();
+  save_board(expected, "unit-test-in.snk");
+  game_state_t* state = initialize_snakes(load_board_sparse("unit-test-in.snk"));
+  frame_ring_t* writer = frame_ring_create("/snake-unit-tests", expected->x_size, expected->y_size, 4);
+  frame_ring_t* reader = frame_ring_attach("/snake-unit-tests");
+  if (!assert_true("ring opened", state != NULL && writer != NULL && reader != NULL)) {
+    return false;
+  }
+
+  frame_t frame;
+  frame.cells = NULL;
+  frame_ring_publish(writer, state, 0);
+  bool result = assert_true("frame read", frame_ring_read(reader, &frame));
+  for (unsigned int y = 0; result && y < expected->y_size; y++) {
+    size_t row_size = expected->x_size + 1;
+    result = assert_true("frame row matches", memcmp(frame.cells + y * row_size, expected->board[y], row_size) == 0);
+  }
+  frame_ring_destroy(writer);
+  free(frame.cells);
+  frame_ring_destroy(reader);
+  free_state(state);
+  free_state(expected);
+  return result;
+}
+
+bool test_frame_ring() {
+  if (!test_frame_ring_board_1()) {
+    printf("%s\n", "test_frame_ring_board_1 failed.");
+    return false;
+  }
+
+  if (!test_frame_ring_board_2()) {
+    printf("%s\n", "test_frame_ring_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_autopilot_board_1() {
+  // the snake heads for the only food and eats it on the shortest path
+  game_state_t* state = create_default_state();
+  autopilot_t* autopilot = autopilot_create(state);
+  if (!assert_true("autopilot created", autopilot != NULL)) {
+    return false;
+  }
+  if (!assert_equals_int("distance ahead of the head", 5, autopilot->dist[4 * 14 + 6])) {
+    return false;
+  }
+
+  for (int i = 0; i < 6; i++) {
+    autopilot_steer_all(state, autopilot);
+    update_state(state, corner_food);
+  }
+  save_board(state, "unit-test-out.snk");
+  bool result = assert_equals_int("snake head x", 9, state->snakes[0].head_x)
+                && assert_equals_int("snake head y", 2, state->snakes[0].head_y)
+                && assert_map_equals(state, 1, 1, '*')
+                && assert_true("distance field repaired, not rebuilt", autopilot->rebuilds == 1);
+  autopilot_destroy(autopilot);
+  free_state(state);
+  return result;
+}
+
+bool test_autopilot_board_2() {
+  // after every tick, the repaired field matches one built from scratch
+  game_state_t* state = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  if (!assert_true("board loaded", state != NULL)) {
+    return false;
+  }
+  autopilot_t* autopilot = autopilot_create(state);
+  bool result = assert_true("autopilot created", autopilot != NULL);
+  size_t cells = (size_t) state->x_size * state->y_size;
+  for (int i = 0; result && i < 200; i++) {
+    autopilot_steer_all(state, autopilot);
+    update_state(state, deterministic_food);
+    autopilot_update(autopilot);
+
+    autopilot_t* fresh = autopilot_create(state);
+    result = assert_true("repaired field matches", memcmp(autopilot->dist, fresh->dist, cells * sizeof(uint32_t)) == 0);
+    autopilot_destroy(fresh);
+  }
+  result = result && assert_true("field repaired", autopilot->repairs > 0);
+  autopilot_destroy(autopilot);
+  free_state(state);
+  return result;
+}
+
+bool test_autopilot() {
+  if (!test_autopilot_board_1()) {
+    printf("%s\n", "test_autopilot_board_1 failed. Check unit-test-out.snk.");
+    return false;
+  }
+
+  if (!test_autopilot_board_2()) {
+    printf("%s\n", "test_autopilot_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_components_board_1() {
+  // walling off the only gap splits the board in two, and opening it joins them again
+  game_state_t* state = create_default_state();
+  components_t* components = components_create(state);
+  if (!assert_true("components created", components != NULL)) {
+    return false;
+  }
+  // 12 * 8 inside the walls, minus the snake
+  if (!assert_equals_int("whole board", 94, components_region_size(components, 1, 1))) {
+    return false;
+  }
+  for (unsigned int y = 1; y < 9; y++) {
+    if (y != 6) {
+      set_board_at(state, 7, y, '#');
+    }
+  }
+  if (!assert_equals_int("left of the gap", 87, components_region_size(components, 1, 1))
+      || !assert_equals_int("right of the gap", 87, components_region_size(components, 12, 8))
+      || !assert_equals_int("blocked cell", 0, components_region_size(components, 7, 1))) {
+    return false;
+  }
+
+  set_board_at(state, 7, 6, '#');
+  bool result = assert_equals_int("left side", 46, components_region_size(components, 1, 1))
+                && assert_equals_int("right side", 40, components_region_size(components, 12, 8))
+                && assert_true("different regions",
+                               components_region(components, 1, 1) != components_region(components, 12, 8));
+  set_board_at(state, 7, 6, ' ');
+  set_board_at(state, 7, 2, '*');
+  result = result && assert_equals_int("joined again", 88, components_region_size(components, 12, 8))
+           && assert_true("same region", components_region(components, 1, 1) == components_region(components, 12, 8));
+  components_destroy(components);
+  free_state(state);
+  return result;
+}
+
+bool test_components_board_2() {
+  // after every tick, every cell's region matches one computed from scratch
+  game_state_t* state = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  if (!assert_true("board loaded", state != NULL)) {
+    return false;
+  }
+  components_t* components = components_create(state);
+  bool result = assert_true("components created", components != NULL);
+  snake_seed = 1;
+  for (int i = 0; result && i < 300; i++) {
+    for (unsigned int j = 0; j < state->num_snakes; j++) {
+      random_turn(state, j);
+    }
+    update_state(state, deterministic_food);
+
+    components_t* fresh = components_create(state);
+    for (unsigned int y = 0; result && y < state->y_size; y++) {
+      for (unsigned int x = 0; result && x < state->x_size; x++) {
+        result = assert_equals_int("region size", components_region_size(fresh, x, y),
+                                   components_region_size(components, x, y));
+        if (result && x > 0 && components_region_size(fresh, x, y) > 0 && components_region_size(fresh, x - 1, y) > 0) {
+          result = assert_true("neighbors in the same region",
+                               components_region(components, x, y) == components_region(components, x - 1, y));
+        }
+      }
+    }
+    components_destroy(fresh);
+  }
+  result = result && assert_true("regions split", components->splits > 0);
+  components_destroy(components);
+  free_state(state);
+  return result;
+}
+
+bool test_components() {
+  if (!test_components_board_1()) {
+    printf("%s\n", "test_components_board_1 failed.");
+    return false;
+  }
+
+  if (!test_components_board_2()) {
+    printf("%s\n", "test_components_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+typedef struct steal_test_t {
+  unsigned int runs[1000];
+  unsigned long work[64];
+} steal_test_t;
+
+void uneven_task(unsigned int worker, size_t task, void* ctx) {
+  steal_test_t* test = ctx;
+  // The last tasks take far longer than the first, so the workers that get them need help
+  volatile unsigned long spin = 0;
+  for (size_t i = 0; i < task * task; i++) {
+    spin += i;
+  }
+  test->runs[task] += 1;
+  test->work[worker] += task;
+}
+
+bool test_parallel_steal_board_1() {
+  // every task runs exactly once, whichever worker ends up with it
+  steal_test_t* test = calloc(1, sizeof(steal_test_t));
+  parallel_set_threads(4);
+  unsigned int workers = parallel_workers(1000);
+  parallel_steal(1000, uneven_task, test);
+  parallel_set_threads(0);
+
+  bool result = assert_equals_int("workers", 4, workers);
+  unsigned long work = 0;
+  for (unsigned int w = 0; w < workers; w++) {
+    work += test->work[w];
+  }
+  result = result && assert_equals_int("total work", 999 * 1000 / 2, work);
+  for (int i = 0; result && i < 1000; i++) {
+    result = assert_equals_int("runs of task", 1, test->runs[i]);
+  }
+  free(test);
+  return result;
+}
+
+bool test_parallel_steal() {
+  if (!test_parallel_steal_board_1()) {
+    printf("%s\n", "test_parallel_steal_board_1 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_replay_board_1() {
+  // seeking to any tick gives back the board, snakes and seeds the game had after that many ticks
+  game_state_t* state = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  if (!assert_true("board loaded", state != NULL)) {
+    return false;
+  }
+  replay_writer_t* writer = replay_writer_create("unit-test-out.rpl", state, 7);
+  bool result = assert_true("writer created", writer != NULL);
+  game_state_t* expected[201];
+  uint32_t seeds[201];
+  seed = 5;
+  snake_seed = 1;
+  for (int i = 0; result && i <= 200; i++) {
+    expected[i] = clone_state(state);
+    seeds[i] = seed;
+    if (i == 200) {
+      break;
+    }
+    for (unsigned int j = 0; i % 3 == 0 && j < state->num_snakes; j++) {
+      if (state->snakes[j].live) {
+        random_turn(state, j);
+      }
+    }
+    replay_record_tick(writer, state);
+    update_state(state, deterministic_food);
+  }
+  result = result && assert_equals_int("writer error", 0, replay_writer_close(writer));
+
+  replay_t* replay = result ? replay_open("unit-test-out.rpl") : NULL;
+  result = result && assert_true("replay opened", replay != NULL);
+  result = result && assert_equals_int("ticks", 200, replay->ticks);
+  result = result && assert_equals_int("keyframes", 29, replay->num_blocks);
+  for (int i = 0; result && i <= 200; i++) {
+    game_state_t* actual = replay_seek(replay, i);
+    result = assert_true("seek", actual != NULL);
+    result = result && assert_true("board", board_hash(expected[i]) == board_hash(actual));
+    result = result && assert_equals_int("seed", seeds[i], seed);
+    for (unsigned int j = 0; result && j < state->num_snakes; j++) {
+      snake_t* a = &expected[i]->snakes[j];
+      snake_t* b = &actual->snakes[j];
+      result = assert_true("snake", a->tail_x == b->tail_x && a->tail_y == b->tail_y && a->head_x == b->head_x &&
+                                        a->head_y == b->head_y && a->live == b->live);
+    }
+    if (actual != NULL) {
+      free_state(actual);
+    }
+  }
+  result = result && assert_true("seek past the end", replay_seek(replay, 201) == NULL);
+
+  if (replay != NULL) {
+    replay_close(replay);
+  }
+  for (int i = 0; i <= 200; i++) {
+    if (expected[i] != NULL) {
+      free_state(expected[i]);
+    }
+  }
+  free_state(state);
+  return result;
+}
+
+bool test_replay_board_2() {
+  // a game where nobody turns costs one bit per tick
+  game_state_t* state = create_default_state();
+  replay_writer_t* writer = replay_writer_create("unit-test-out.rpl", state, 1000);
+  bool result = assert_true("writer created", writer != NULL);
+  for (int i = 0; result && i < 800; i++) {
+    replay_record_tick(writer, state);
+    update_state(state, deterministic_food);
+  }
+  result = result && assert_equals_int("writer error", 0, replay_writer_close(writer));
+
+  replay_t* replay = result ? replay_open("unit-test-out.rpl") : NULL;
+  result = result && assert_true("replay opened", replay != NULL);
+  result = result && assert_equals_int("keyframes", 1, replay->num_blocks);
+  // Two 24 byte headers, one snake, 10 rows of 14 cells and a newline, then 800 bits of turns
+  result = result && assert_true("seek to end", fseek(replay->file, 0, SEEK_END) == 0);
+  result = result && assert_equals_int("file size", 24 + 24 + 17 + 150 + 100, ftell(replay->file));
+  if (replay != NULL) {
+    replay_close(replay);
+  }
+  free_state(state);
+  return result;
+}
+
+bool test_replay() {
+  if (!test_replay_board_1()) {
+    printf("%s\n", "test_replay_board_1 failed.");
+    return false;
+  }
+
+  if (!test_replay_board_2()) {
+    printf("%s\n", "test_replay_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool fixed_engine_matches(game_state_t* start) {
+  game_state_t* expected = clone_state(start);
+  game_state_t* actual = clone_state(start);
+  uint32_t expected_seed = 1;
+  uint32_t actual_seed = 1;
+  bool result = true;
+  snake_seed = 1;
+  for (int i = 0; result && i < 300; i++) {
+    for (unsigned int j = 0; i % 4 == 0 && j < expected->num_snakes; j++) {
+      snake_t* snake = &expected->snakes[j];
+      if (snake->live) {
+        random_turn(expected, j);
+        set_board_at(actual, snake->head_x, snake->head_y, get_board_at(expected, snake->head_x, snake->head_y));
+      }
+    }
+    seed = expected_seed;
+    update_state(expected, deterministic_food);
+    expected_seed = seed;
+    seed = actual_seed;
+    fixed_update_state(actual, deterministic_food);
+    actual_seed = seed;
+
+    result = assert_true("board", expected->hash == actual->hash && actual->hash == board_hash(actual));
+    result = result && assert_equals_int("food seed", expected_seed, actual_seed);
+    for (unsigned int j = 0; result && j < expected->num_snakes; j++) {
+      snake_t* a = &expected->snakes[j];
+      snake_t* b = &actual->snakes[j];
+      result = assert_true("snake", a->tail_x == b->tail_x && a->tail_y == b->tail_y && a->head_x == b->head_x &&
+                                        a->head_y == b->head_y && a->live == b->live);
+    }
+  }
+  free_state(expected);
+  free_state(actual);
+  return result;
+}
+
+bool test_fixed_engine_board_1() {
+  // the specialized engines play exactly the same games as update_state
+  char* filenames[] = {"tests/1-simple-in.snk", "tests/8-multisnake-in.snk", "tests/9-everything-in.snk"};
+  bool result = true;
+  for (int i = 0; result && i < 3; i++) {
+    game_state_t* state = initialize_snakes(load_board(filenames[i]));
+    result = assert_true("board loaded", state != NULL) && fixed_engine_matches(state);
+    if (state != NULL) {
+      free_state(state);
+    }
+  }
+  if (result) {
+    game_state_t* state = create_default_state();
+    result = fixed_engine_matches(state);
+    free_state(state);
+  }
+  return result;
+}
+
+bool test_fixed_engine_board_2() {
+  // every shape picks its own engine, and any other shape falls back to update_state
+  game_state_t state;
+  state.sparse = NULL;
+  bool result = true;
+  for (unsigned int i = 0; result && i < num_fixed_sizes; i++) {
+    state.x_size = fixed_sizes[i].x_size;
+    state.y_size = fixed_sizes[i].y_size;
+    state.num_snakes = fixed_sizes[i].num_snakes;
+    result = assert_true("specialized engine", fixed_engine_for(&state) == fixed_sizes[i].update);
+    state.num_snakes += 1000;
+    result = result && assert_true("generic engine", fixed_engine_for(&state) == update_state);
+  }
+  return result;
+}
+
+bool test_fixed_engine() {
+  if (!test_fixed_engine_board_1()) {
+    printf("%s\n", "test_fixed_engine_board_1 failed.");
+    return false;
+  }
+
+  if (!test_fixed_engine_board_2()) {
+    printf("%s\n", "test_fixed_engine_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool files_equal(char* a, char* b) {
+  FILE* fa = fopen(a, "r");
+  FILE* fb = fopen(b, "r");
+  bool equal = fa != NULL && fb != NULL;
+  int ca;
+  int cb;
+  while (equal) {
+    ca = fgetc(fa);
+    cb = fgetc(fb);
+    equal = ca == cb;
+    if (ca == EOF || cb == EOF) {
+      break;
+    }
+  }
+  if (fa != NULL) {
+    fclose(fa);
+  }
+  if (fb != NULL) {
+    fclose(fb);
+  }
+  return equal;
+}
+
+bool test_sparse_board_board_1() {
+  // a sparse board plays exactly the same game as rows do, and prints the same
+  game_state_t* dense = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  game_state_t* sparse = initialize_snakes(load_board_sparse("tests/9-everything-in.snk"));
+  bool result = assert_true("boards loaded", dense != NULL && sparse != NULL);
+  result = result && assert_equals_int("snakes", dense->num_snakes, sparse->num_snakes);
+  uint32_t dense_seed = 1;
+  uint32_t sparse_seed = 1;
+  snake_seed = 1;
+  for (int i = 0; result && i < 200; i++) {
+    for (unsigned int j = 0; i % 3 == 0 && j < dense->num_snakes; j++) {
+      snake_t* snake = &dense->snakes[j];
+      if (snake->live) {
+        random_turn(dense, j);
+        set_board_at(sparse, snake->head_x, snake->head_y, get_board_at(dense, snake->head_x, snake->head_y));
+      }
+    }
+    seed = dense_seed;
+    update_state(dense, deterministic_food);
+    dense_seed = seed;
+    seed = sparse_seed;
+    update_state(sparse, deterministic_food);
+    sparse_seed = seed;
+
+    result = assert_true("hash", dense->hash == sparse->hash && sparse->hash == board_hash(sparse));
+    for (unsigned int j = 0; result && j < dense->num_snakes; j++) {
+      result = assert_true("snake", memcmp(&dense->snakes[j], &sparse->snakes[j], sizeof(snake_t)) == 0);
+    }
+  }
+  if (result) {
+    save_board(dense, "unit-test-ref.snk");
+    save_board(sparse, "unit-test-out.snk");
+    result = assert_true("printed boards", files_equal("unit-test-ref.snk", "unit-test-out.snk"));
+  }
+  if (dense != NULL) {
+    free_state(dense);
+  }
+  if (sparse != NULL) {
+    free_state(sparse);
+  }
+  return result;
+}
+
+bool test_sparse_board_board_2() {
+  // chunks come and go with their cells, and the board always reads like a plain array
+  game_state_t* state = create_sparse_state(1000, 1000);
+  // 63 chunks along each edge, sharing the corners
+  bool result = assert_equals_int("wall chunks", 248, state->sparse->num_chunks);
+  set_board_at(state, 500, 500, '*');
+  result = result && assert_equals_int("chunk added", 249, state->sparse->num_chunks);
+  set_board_at(state, 500, 500, ' ');
+  result = result && assert_equals_int("chunk released", 248, state->sparse->num_chunks);
+  free_state(state);
+
+  state = create_sparse_state(200, 200);
+  char* cells = malloc(200 * 200);
+  for (int i = 0; i < 200 * 200; i++) {
+    cells[i] = get_board_at(state, i % 200, i / 200);
+  }
+  uint32_t test_seed = 7;
+  for (int i = 0; result && i < 100000; i++) {
+    int x = 1 + det_rand(&test_seed) % 198;
+    int y = 1 + det_rand(&test_seed) % 198;
+    char ch = i % 3 == 0 ? '*' : ' ';
+    set_board_at(state, x, y, ch);
+    cells[y * 200 + x] = ch;
+    if (i % 1000 == 0) {
+      for (int c = 0; result && c < 200 * 200; c++) {
+        result = assert_equals_char("cell", cells[c], get_board_at(state, c % 200, c / 200));
+      }
+      result = result && assert_true("hash", state->hash == board_hash(state));
+    }
+  }
+  game_state_t* clone = clone_state(state);
+  result = result && assert_true("clone equal", sparse_board_equal(state->sparse, clone->sparse));
+  set_board_at(clone, 100, 100, clone->sparse == NULL || get_board_at(clone, 100, 100) == '*' ? ' ' : '*');
+  result = result && assert_true("clone separate", !sparse_board_equal(state->sparse, clone->sparse));
+  free_state(clone);
+  free(cells);
+  free_state(state);
+  return result;
+}
+
+bool test_sparse_board() {
+  if (!test_sparse_board_board_1()) {
+    printf("%s\n", "test_sparse_board_board_1 failed. Check unit-test-out.snk and unit-test-ref.snk.");
+    return false;
+  }
+
+  if (!test_sparse_board_board_2()) {
+    printf("%s\n", "test_sparse_board_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+/* Sends requests to a daemon worker over a socket pair and reads back everything it answers. */
+bool serve_requests(daemon_worker_t* worker, const char* requests, size_t len, char* responses, size_t capacity,
+                    size_t* responses_len) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  write(fds[0], requests, len);
+  shutdown(fds[0], SHUT_WR);
+  bool served = daemon_serve(worker, fds[1]);
+  close(fds[1]);
+  *responses_len = 0;
+  ssize_t n;
+  while ((n = read(fds[0], responses + *responses_len, capacity - *responses_len)) > 0) {
+    *responses_len += n;
+  }
+  close(fds[0]);
+  return served;
+}
+
+bool test_daemon_board_1() {
+  // text and binary requests on one connection get the board ./snake -n would print, or the load error
+  FILE* f = fopen("tests/9-everything-in.snk", "rb");
+  char board[4096];
+  size_t board_len = fread(board, 1, sizeof(board), f);
+  fclose(f);
+  char* bad = "#####\n#  #\n#####\n";
+
+  char requests[16384];
+  size_t len = sprintf(requests, "%d %zu\n", 7, board_len);
+  memcpy(requests + len, board, board_len);
+  len += board_len;
+  daemon_put_request((uint8_t*) requests + len, 30, board_len);
+  len += DAEMON_REQUEST_HEADER_SIZE;
+  memcpy(requests + len, board, board_len);
+  len += board_len;
+  len += sprintf(requests + len, "1 %zu\n%s", strlen(bad), bad);
+
+  daemon_worker_t* worker = daemon_worker_create(14, 10, 2, DAEMON_MAX_BOARD, DAEMON_MAX_TICKS);
+  char responses[16384];
+  size_t responses_len;
+  bool result = assert_true("connection served", serve_requests(worker, requests, len, responses, sizeof(responses),
+                                                                &responses_len));
+  result = result && assert_equals_int("requests", 3, worker->requests);
+  daemon_worker_destroy(worker);
+
+  // the same runs, done here
+  unsigned long ticks[] = {7, 30};
+  game_state_t* expected[2];
+  for (int i = 0; i < 2; i++) {
+    expected[i] = initialize_snakes(load_board("tests/9-everything-in.snk"));
+    seed = 1;
+    snake_seed = 1;
+    sim_result_t sim;
+    simulate(expected[i], deterministic_food, NULL, NULL, ticks[i], true, &sim);
+  }
+  size_t board_size = expected[0]->y_size * (expected[0]->x_size + 1);
+
+  char header[64];
+  size_t pos = sprintf(header, "ok %016" PRIx64 " %zu\n", expected[0]->hash, board_size);
+  result = result && assert_true("text header", memcmp(responses, header, pos) == 0);
+  for (unsigned int y = 0; result && y < expected[0]->y_size; y++) {
+    result = assert_true("text board", memcmp(responses + pos, expected[0]->board[y], expected[0]->x_size + 1) == 0);
+    pos += expected[0]->x_size + 1;
+  }
+
+  uint32_t status;
+  uint64_t hash;
+  uint32_t length;
+  result = result && assert_true("binary header", daemon_get_response((uint8_t*) responses + pos, &status, &hash, &length));
+  result = result && assert_true("binary result", status == 0 && hash == expected[1]->hash && length == board_size);
+  pos += DAEMON_RESPONSE_HEADER_SIZE;
+  for (unsigned int y = 0; result && y < expected[1]->y_size; y++) {
+    result = assert_true("binary board", memcmp(responses + pos, expected[1]->board[y], expected[1]->x_size + 1) == 0);
+    pos += expected[1]->x_size + 1;
+  }
+
+  char* error = "error board:2:5: row is shorter than the first row\n";
+  result = result && assert_true("load error", responses_len == pos + strlen(error)
+                                                   && memcmp(responses + pos, error, strlen(error)) == 0);
+  free_state(expected[0]);
+  free_state(expected[1]);
+  return result;
+}
+
+bool test_daemon_board_2() {
+  // a malformed header, an oversized board or a request cut short ends the connection
+  char* requests[] = {"5 x\n#\n", "5 100\n#", "5 1000000\n"};
+  char* expected[] = {"error malformed request\n", "", "error board is too large\n"};
+  daemon_worker_t* worker = daemon_worker_create(14, 10, 2, 1000, DAEMON_MAX_TICKS);
+  bool result = true;
+  for (int i = 0; result && i < 3; i++) {
+    char responses[256];
+    size_t responses_len;
+    bool served = serve_requests(worker, requests[i], strlen(requests[i]), responses, sizeof(responses), &responses_len);
+    result = assert_true("connection failed", !served);
+    result = result && assert_true("response", responses_len == strlen(expected[i])
+                                                   && memcmp(responses, expected[i], responses_len) == 0);
+  }
+  result = result && assert_equals_int("no requests run", 0, worker->requests);
+  daemon_worker_destroy(worker);
+  return result;
+}
+
+bool test_daemon_board_3() {
+  // a board with nowhere to put food still finishes, and too many ticks only fails that request
+  char* board = "#####\n#d>*#\n#####\n";
+  char* after = "#####\n#d>x#\n#####\n";
+  char requests[256];
+  size_t len = sprintf(requests, "5 %zu\n%s11 %zu\n%s", strlen(board), board, strlen(board), board);
+  daemon_worker_t* worker = daemon_worker_create(14, 10, 2, DAEMON_MAX_BOARD, 10);
+  char responses[256];
+  size_t responses_len;
+  bool result = assert_true("connection served", serve_requests(worker, requests, len, responses, sizeof(responses),
+                                                                &responses_len));
+  char* ok_end = memchr(responses, '\n', responses_len);
+  char* error = "error too many ticks\n";
+  size_t pos = ok_end == NULL ? 0 : ok_end + 1 - responses;
+  result = result && assert_true("ok response", ok_end != NULL && memcmp(responses, "ok ", 3) == 0);
+  result = result && assert_true("full board", responses_len >= pos + strlen(after)
+                                                   && memcmp(responses + pos, after, strlen(after)) == 0);
+  pos += strlen(after);
+  result = result && assert_true("tick limit", responses_len == pos + strlen(error)
+                                                   && memcmp(responses + pos, error, strlen(error)) == 0);
+  result = result && assert_equals_int("requests", 1, worker->requests);
+  daemon_worker_destroy(worker);
+  return result;
+}
+
+bool test_daemon() {
+  if (!test_daemon_board_1()) {
+    printf("%s\n", "test_daemon_board_1 failed.");
+    return false;
+  }
+
+  if (!test_daemon_board_2()) {
+    printf("%s\n", "test_daemon_board_2 failed.");
+    return false;
+  }
+
+  if (!test_daemon_board_3()) {
+    printf("%s\n", "test_daemon_board_3 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+/* Whether the live list holds exactly the live snakes, in the order they are numbered. */
+bool live_list_matches(game_state_t* state) {
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < state->num_snakes; i++) {
+    if (state->snakes[i].live) {
+      if (j >= state->num_live || state->live_snakes[j] != i) {
+        return false;
+      }
+      j++;
+    }
+  }
+  return j == state->num_live;
+}
+
+bool test_live_snakes_board_1() {
+  // the list shrinks as snakes die, and stays in numbering order until nobody is left
+  game_state_t* state = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  bool result = assert_true("board loaded", state != NULL);
+  result = result && assert_equals_int("live snakes", 4, state->num_live);
+  uint32_t start_seed = seed;
+  for (unsigned int t = 0; result && t < 100; t++) {
+    update_state(state, deterministic_food);
+    result = assert_true("live list", live_list_matches(state));
+    if (t == 0) {
+      result = result && assert_equals_int("live snakes after one tick", 3, state->num_live);
+    }
+  }
+  result = result && assert_equals_int("live snakes at the end", 0, state->num_live);
+  seed = start_seed;
+  if (state != NULL) {
+    free_state(state);
+  }
+  return result;
+}
+
+bool test_live_snakes_board_2() {
+  // clones get their own list, and refresh_live_snakes follows edits to the snake table
+  game_state_t* state = initialize_snakes(load_board("tests/9-everything-in.snk"));
+  game_state_t* clone = clone_state(state);
+  state->snakes[1].live = false;
+  refresh_live_snakes(state);
+  bool result = assert_equals_int("live snakes", 3, state->num_live);
+  result = result && assert_true("live list", live_list_matches(state));
+  result = result && assert_equals_int("clone live snakes", 4, clone->num_live);
+  result = result && assert_true("clone live list", live_list_matches(clone));
+  state->snakes[1].live = true;
+  refresh_live_snakes(state);
+  result = result && assert_equals_int("live snakes restored", 4, state->num_live);
+  result = result && assert_true("restored live list", live_list_matches(state));
+  free_state(state);
+  free_state(clone);
+  return result;
+}
+
+bool test_live_snakes() {
+  if (!test_live_snakes_board_1()) {
+    printf("%s\n", "test_live_snakes_board_1 failed.");
+    return false;
+  }
+
+  if (!test_live_snakes_board_2()) {
+    printf("%s\n", "test_live_snakes_board_2 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_board_check_board_1() {
+  // the SSE2 and scalar paths find the same first byte, at every alignment and length
+  char bytes[96];
+  char* bad = "\n\r\tb%\x80\xff";
+  bool result = true;
+  for (size_t offset = 0; result && offset < 16; offset++) {
+    for (size_t len = 0; result && len <= 64; len++) {
+      for (size_t at = 0; result && at <= len; at++) {
+        memset(bytes, 'x', sizeof(bytes));
+        for (size_t i = 0; i < len; i++) {
+          bytes[offset + i] = "# *^<>vxwasd"[(i * 7 + at) % 12];
+        }
+        bytes[offset + at] = at < len ? bad[(offset + at) % 7] : bytes[offset + at];
+        result = assert_equals_int("first bad character", at, board_check_chars(bytes + offset, len));
+
+        memset(bytes, '#', sizeof(bytes));
+        bytes[offset + at] = at < len ? ' ' : '#';
+        result = result && assert_equals_int("first gap in a wall", at, board_check_walls(bytes + offset, len));
+
+        memset(bytes, ' ', sizeof(bytes));
+        bytes[offset + at] = at < len ? '*' : ' ';
+        result = result && assert_equals_int("first cell", at, board_next_cell(bytes + offset, len));
+      }
+    }
+  }
+  return result;
+}
+
+/* Loads contents with load and returns what it wrote to stderr, or "" if it loaded. */
+char* load_error(game_state_t* (*load)(char*), char* contents, char* message, size_t size) {
+  FILE* f = fopen("unit-test-in.snk", "w");
+  fputs(contents, f);
+  fclose(f);
+
+  fflush(stderr);
+  int saved_stderr = dup(STDERR_FILENO);
+  f = fopen("unit-test-out.snk", "w");
+  dup2(fileno(f), STDERR_FILENO);
+  game_state_t* state = load("unit-test-in.snk");
+  fflush(stderr);
+  dup2(saved_stderr, STDERR_FILENO);
+  close(saved_stderr);
+  fclose(f);
+
+  message[0] = '\0';
+  f = fopen("unit-test-out.snk", "r");
+  if (fgets(message, size, f) == NULL || state != NULL) {
+    message[0] = '\0';
+  }
+  fclose(f);
+  if (state != NULL) {
+    free_state(state);
+  }
+  return message;
+}
+
+game_state_t* load_board_from_file_contents(char* filename) {
+  FILE* f = fopen(filename, "r");
+  char buf[256];
+  size_t len = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  return load_board_from_memory(filename, buf, len);
+}
+
+bool test_board_check_board_2() {
+  // every loader rejects the same boards and points at the same place
+  char* boards[][2] = {
+    {"#####\n# * #\n#####\n", ""},
+    {"#####\n  * #\n#####\n", "unit-test-in.snk:2:1: border is not a wall\n"},
+    {"#####\n# *  \n#####\n", "unit-test-in.snk:2:5: border is not a wall\n"},
+    {"## ##\n# * #\n#####\n", "unit-test-in.snk:1:3: border is not a wall\n"},
+    {"#####\n# * #\n#### \n", "unit-test-in.snk:3:5: border is not a wall\n"},
+    {"#####\n b* #\n#####\n", "unit-test-in.snk:2:1: border is not a wall\n"},
+    {"#####\n#b*  \n#####\n", "unit-test-in.snk:2:2: unexpected character\n"},
+    {"#####\n#  *#\n#####\n#\xff###\n#####\n", "unit-test-in.snk:4:2: unexpected character\n"},
+    {"#####\n# * \n#####\n", "unit-test-in.snk:2:5: row is shorter than the first row\n"},
+    {"#####\n# * ##\n#####\n", "unit-test-in.snk:2:6: row is longer than the first row\n"},
+    {"#####\n# * #\n# ", "unit-test-in.snk:3:3: row is shorter than the first row\n"},
+    {"######\n#d>v #\n# ^< #\n######\n", "unit-test-in.snk:2:2: snake body loops back on itself\n"},
+    {"########\n#d>>>v #\n#  ^ v #\n#  ^<< #\n########\n", "unit-test-in.snk:2:2: snake body loops back on itself\n"},
+  };
+  game_state_t* (*loaders[])(char*) = {load_board, load_board_mapped, load_board_sparse, load_board_from_file_contents};
+  char* names[] = {"load_board", "load_board_mapped", "load_board_sparse", "load_board_from_memory"};
+  char message[256];
+  bool result = true;
+  for (size_t i = 0; result && i < sizeof(boards) / sizeof(boards[0]); i++) {
+    for (size_t j = 0; result && j < sizeof(loaders) / sizeof(loaders[0]); j++) {
+      load_error(loaders[j], boards[i][0], message, sizeof(message));
+      result = assert_true(names[j], strcmp(message, boards[i][1]) == 0);
+      if (!result) {
+        printf("board %zu: expected \"%s\", got \"%s\"\n", i, boards[i][1], message);
+      }
+    }
+  }
+  return result;
+}
+
+bool test_board_check_board_3() {
+  // a loop drawn on a board after it was loaded leaves its snake dead instead of hanging
+  char board[] = "######\n#d>v #\n#  v #\n######\n";
+  game_state_t* state = load_board_from_memory("board", board, strlen(board));
+  set_board_at(state, 3, 2, '<');
+  set_board_at(state, 2, 2, '^');
+  initialize_snakes(state);
+  bool result = assert_equals_int("snakes", 1, state->num_snakes);
+  result = result && assert_equals_int("live snakes", 0, state->num_live);
+  free_state(state);
+  return result;
+}
+
+bool test_board_check() {
+  if (!test_board_check_board_1()) {
+    printf("%s\n", "test_board_check_board_1 failed.");
+    return false;
+  }
+
+  if (!test_board_check_board_2()) {
+    printf("%s\n", "test_board_check_board_2 failed.");
+    return false;
+  }
+
+  if (!test_board_check_board_3()) {
+    printf("%s\n", "test_board_check_board_3 failed.");
+    return false;
+  }
+
+  return true;
+}
+
+/*
+  Microbenchmarks for unit-tests --bench. Each one calls a helper in a tight loop on boards like
+  the ones the tests above build, and reports stats_now() ticks per call: the best of BENCH_RUNS
+  runs, less the cost of resetting the board where the helper changes it. Results are checked
+  against a baseline file after scaling by a calibration loop, so a baseline taken on another
+  machine (or under load) still tells a regression from a slower CPU.
+*/
+
+#define BENCH_RUNS 25
+#define BENCH_BASELINE "tests/bench-baseline.txt"
+#define BENCH_THRESHOLD 25.0
+// update_head and update_tail move the snake this many cells before the board is reset
+#define BENCH_MOVES 10
+
+typedef struct micro_bench_t {
+  const char* name;
+  unsigned long iterations;
+  // Calls the helper iterations times and returns something the results depend on
+  unsigned long (*run)(unsigned long iterations);
+  // The same loop without the helper, or NULL if the loop does nothing else
+  unsigned long (*overhead)(unsigned long iterations);
+} micro_bench_t;
+
+static volatile char bench_chars[16] = "# *wasd^<v>x*#w ";
+static game_state_t* bench_default;
+static game_state_t* bench_winding;
+static game_state_t* bench_state;
+static game_state_t* bench_runway;
+static game_state_t* bench_long;
+
+/* Copies the board and snake of fixture over bench_state, whose rows are its own. */
+static void bench_reset(game_state_t* fixture) {
+  for (unsigned int y = 0; y < fixture->y_size; y++) {
+    memcpy(bench_state->board[y], fixture->board[y], fixture->x_size);
+  }
+  bench_state->snakes[0] = fixture->snakes[0];
+  bench_state->hash = fixture->hash;
+}
+
+unsigned long bench_calibration(unsigned long iterations) {
+  volatile unsigned long x = 1;
+  for (unsigned long i = 0; i < iterations; i++) {
+    x = x * 2654435761u + i;
+  }
+  return x;
+}
+
+unsigned long bench_is_tail(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    sum += is_tail(bench_chars[i & 15]);
+  }
+  return sum;
+}
+
+unsigned long bench_is_snake(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    sum += is_snake(bench_chars[i & 15]);
+  }
+  return sum;
+}
+
+unsigned long bench_body_to_tail(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    sum += body_to_tail(bench_chars[i & 15]);
+  }
+  return sum;
+}
+
+unsigned long bench_incr_x(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    sum += incr_x(bench_chars[i & 15]);
+  }
+  return sum;
+}
+
+unsigned long bench_incr_y(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    sum += incr_y(bench_chars[i & 15]);
+  }
+  return sum;
+}
+
+unsigned long bench_next_square(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    sum += next_square(bench_default, 0);
+  }
+  return sum;
+}
+
+unsigned long bench_find_head(unsigned long iterations) {
+  unsigned long sum = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    find_head(bench_winding, 0);
+    sum += bench_winding->snakes[0].head_x;
+  }
+  return sum;
+}
+
+unsigned long bench_update_head(unsigned long iterations) {
+  for (unsigned long i = 0; i < iterations; i++) {
+    if (i % BENCH_MOVES == 0) {
+      bench_reset(bench_runway);
+    }
+    update_head(bench_state, 0);
+  }
+  return bench_state->snakes[0].head_x;
+}
+
+unsigned long bench_update_tail(unsigned long iterations) {
+  for (unsigned long i = 0; i < iterations; i++) {
+    if (i % BENCH_MOVES == 0) {
+      bench_reset(bench_long);
+    }
+    update_tail(bench_state, 0);
+  }
+  return bench_state->snakes[0].tail_x;
+}
+
+unsigned long bench_reset_overhead(unsigned long iterations) {
+  for (unsigned long i = 0; i < iterations; i++) {
+    if (i % BENCH_MOVES == 0) {
+      bench_reset(bench_long);
+    }
+  }
+  return bench_state->snakes[0].tail_x;
+}
+
+static const micro_bench_t micro_benches[] = {
+  {"is_tail", 1000000, bench_is_tail, NULL},
+  {"is_snake", 1000000, bench_is_snake, NULL},
+  {"body_to_tail", 1000000, bench_body_to_tail, NULL},
+  {"incr_x", 1000000, bench_incr_x, NULL},
+  {"incr_y", 1000000, bench_incr_y, NULL},
+  {"next_square", 500000, bench_next_square, NULL},
+  {"find_head", 100000, bench_find_head, NULL},
+  {"update_head", 250000, bench_update_head, bench_reset_overhead},
+  {"update_tail", 250000, bench_update_tail, bench_reset_overhead},
+};
+
+#define NUM_MICRO_BENCHES (sizeof(micro_benches) / sizeof(micro_benches[0]))
+
+volatile unsigned long bench_sink;
+
+/* Ticks per iteration of one run. */
+double bench_once(unsigned long (*run)(unsigned long iterations), unsigned long iterations) {
+  uint64_t start = stats_now();
+  bench_sink += run(iterations);
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* Keeps the smaller of best and ticks, taking ticks if this is the first run. */
+void bench_keep_best(double* best, double ticks, int run) {
+  if (run == 0 || ticks < *best) {
+    *best = ticks;
+  }
+}
+
+/* Builds the boards the benchmarks run on, from the same setups as the tests. */
+void bench_fixtures() {
+  bench_default = create_default_state();
+
+  // The winding snake of test_find_head_board_1
+  bench_winding = create_default_state();
+  set_board_at(bench_winding, 6, 4, 'v');
+  set_board_at(bench_winding, 6, 5, 'v');
+  set_board_at(bench_winding, 6, 6, 'v');
+  set_board_at(bench_winding, 6, 7, '<');
+  set_board_at(bench_winding, 5, 7, '<');
+  set_board_at(bench_winding, 4, 7, '<');
+  set_board_at(bench_winding, 3, 7, '^');
+  set_board_at(bench_winding, 3, 6, '^');
+
+  // A short snake at the left edge with room to move BENCH_MOVES cells right
+  bench_runway = create_default_state();
+  set_board_at(bench_runway, 4, 4, ' ');
+  set_board_at(bench_runway, 5, 4, ' ');
+  set_board_at(bench_runway, 1, 4, 'd');
+  set_board_at(bench_runway, 2, 4, '>');
+  bench_runway->snakes[0].tail_x = 1;
+  bench_runway->snakes[0].head_x = 2;
+
+  // A snake across the whole row, with room to shrink BENCH_MOVES cells
+  bench_long = create_default_state();
+  set_board_at(bench_long, 1, 4, 'd');
+  for (int x = 2; x <= 12; x++) {
+    set_board_at(bench_long, x, 4, '>');
+  }
+  bench_long->snakes[0].tail_x = 1;
+  bench_long->snakes[0].head_x = 12;
+
+  bench_state = create_default_state();
+}
+
+/* Reads a baseline written by --save-baseline into values (in micro_benches order). Returns false if it can't. */
+bool read_baseline(const char* filename, double* calibration, double* values) {
+  FILE* f = fopen(filename, "r");
+  if (f == NULL) {
+    return false;
+  }
+  *calibration = 0;
+  for (int i = 0; i < NUM_MICRO_BENCHES; i++) {
+    values[i] = 0;
+  }
+  char line[128];
+  char name[64];
+  double value;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#' || sscanf(line, "%63s %lf", name, &value) != 2) {
+      continue;
+    }
+    if (strcmp(name, "calibration") == 0) {
+      *calibration = value;
+    }
+    for (int i = 0; i < NUM_MICRO_BENCHES; i++) {
+      if (strcmp(name, micro_benches[i].name) == 0) {
+        values[i] = value;
+      }
+    }
+  }
+  fclose(f);
+  return *calibration > 0;
+}
+
+/*
+  Runs every microbenchmark and compares it to the baseline in filename, or overwrites the
+  baseline with the results if save is set. Returns false if any helper got more than threshold
+  percent slower than its scaled baseline.
+*/
+bool run_micro_benches(const char* filename, double threshold, bool save) {
+  bench_fixtures();
+  // Every run goes through all the benchmarks once, so a burst of noise spoils one run of each
+  // rather than every run of one
+  double calibration = 0;
+  double results[NUM_MICRO_BENCHES];
+  double overheads[NUM_MICRO_BENCHES];
+  for (int r = 0; r < BENCH_RUNS; r++) {
+    bench_keep_best(&calibration, bench_once(bench_calibration, 1000000), r);
+    for (int i = 0; i < NUM_MICRO_BENCHES; i++) {
+      const micro_bench_t* bench = &micro_benches[i];
+      bench_keep_best(&results[i], bench_once(bench->run, bench->iterations), r);
+      if (bench->overhead != NULL) {
+        bench_keep_best(&overheads[i], bench_once(bench->overhead, bench->iterations), r);
+      }
+    }
+  }
+  for (int i = 0; i < NUM_MICRO_BENCHES; i++) {
+    if (micro_benches[i].overhead != NULL) {
+      results[i] -= overheads[i];
+    }
+  }
+  free_state(bench_default);
+  free_state(bench_winding);
+  free_state(bench_runway);
+  free_state(bench_long);
+  free_state(bench_state);
+
+  if (save) {
+    FILE* f = fopen(filename, "w");
+    if (f == NULL) {
+      printf("Can't write %s\n", filename);
+      return false;
+    }
+    fprintf(f, "# unit-tests --bench baseline: stats_now() ticks per call, best of %d runs\n", BENCH_RUNS);
+    fprintf(f, "calibration %.3f\n", calibration);
+    for (int i = 0; i < NUM_MICRO_BENCHES; i++) {
+      fprintf(f, "%s %.3f\n", micro_benches[i].name, results[i]);
+    }
+    fclose(f);
+    printf("Wrote %s\n", filename);
+    return true;
+  }
+
+  double baseline_calibration;
+  double baseline[NUM_MICRO_BENCHES];
+  if (!read_baseline(filename, &baseline_calibration, baseline)) {
+    printf("No baseline in %s; run %s to record one.\n", filename, "unit-tests --bench --save-baseline");
+    return false;
+  }
+  // Everything is expected to be slower by as much as the calibration loop is
+  double scale = calibration / baseline_calibration;
+  printf("%-14s %10s %10s %8s\n", "helper", "ticks", "baseline", "change");
+  printf("%-14s %10.2f %10.2f\n", "calibration", calibration, baseline_calibration);
+  bool result = true;
+  for (int i = 0; i < NUM_MICRO_BENCHES; i++) {
+    if (baseline[i] <= 0) {
+      printf("%-14s %10.2f %10s\n", micro_benches[i].name, results[i], "-");
+      continue;
+    }
+    double expected = baseline[i] * scale;
+    double change = 100.0 * (results[i] - expected) / expected;
+    bool regressed = change > threshold;
+    printf("%-14s %10.2f %10.2f %+7.1f%%%s\n", micro_benches[i].name, results[i], expected, change,
+           regressed ? "  REGRESSED" : "");
+    result = result && !regressed;
+  }
+  if (result) {
+    printf("%sNo helper is more than %.0f%% slower than its baseline.%s\n", COLOR_GREEN, threshold, COLOR_RESET);
+  } else {
+    printf("Some helpers are more than %.0f%% slower than their baseline.\n", threshold);
+  }
+  return result;
+}
+
+void init_colors() {
+  if (getenv("NO_COLOR") != NULL) {
+    return;
+  }
+
+  char* term = getenv("TERM");
+  if (term == NULL || strstr(term, "xterm") == NULL) {
+    return;
+  }
+
+  COLOR_GREEN = "\033[0;32m";
+  COLOR_RESET = "\033[0m";
+}
+
+bool test_and_print(char* label, bool (*run_test)()) {
+  printf("\nTesting %s...\n", label);
+  bool result = run_test();
+  if (result) {
+    printf("%sAll %s tests passed!%s\n", COLOR_GREEN, label, COLOR_RESET);
+  } else {
+    printf("Not all %s tests passed.\n", label);
+  }
+  return result;
+}
+
+/*
+  Feel free to comment out tests.
+*/
+int main(int argc, char* argv[]) {
+  bool MEMCHECK_MODE = false;
+  bool BENCH_MODE = false;
+  bool save_baseline = false;
+  char* baseline_filename = BENCH_BASELINE;
+  double threshold = BENCH_THRESHOLD;
+
+  // Parse arguments
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0) {
+      MEMCHECK_MODE = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--bench") == 0) {
+      BENCH_MODE = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--save-baseline") == 0) {
+      save_baseline = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--baseline") == 0 && i < argc - 1) {
+      baseline_filename = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--threshold") == 0 && i < argc - 1) {
+      threshold = strtod(argv[i + 1], NULL);
+      i++;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s [-m] [--bench [--baseline filename] [--threshold percent] [--save-baseline]]\n", argv[0]);
+    return 1;
+  }
+
+  init_colors();
+
+  if (BENCH_MODE) {
+    return run_micro_benches(baseline_filename, threshold, save_baseline) ? 0 : 1;
+  }
+
+  printf("%s\n", "Reminder: These tests are not comprehensive, and passing them does not guarantee that your implementation is working.");
+
+  if (MEMCHECK_MODE) {
+    printf("\nTesting free_state...\n");
+    if (!test_free_state()) {
+      return 0;
+    }
+  } else {
+    if (!test_and_print("create_default_state", test_create_default_state)) {
+      return 0;
+    }
+    if (!test_and_print("print_board", test_print_board)) {
+      return 0;
+    }
+    if (!test_and_print("helpers", test_helpers)) {
+      return 0;
+    }
+    if (!test_and_print("next_square", test_next_square)) {
+      return 0;
+    }
+    if (!test_and_print("update_head", test_update_head)) {
+      return 0;
+    }
+    if (!test_and_print("update_tail", test_update_tail)) {
+      return 0;
+    }
+    if (!test_and_print("update_state", test_update_state)) {
+      return 0;
+    }
+    if (!test_and_print("load_board", test_load_board)) {
+      return 0;
+    }
+    if (!test_and_print("find_head", test_find_head)) {
+      return 0;
+    }
+    if (!test_and_print("initialize_snakes", test_initialize_snakes)) {
+      return 0;
+    }
+    if (!test_and_print("arena_state", test_arena_state)) {
+      return 0;
+    }
+    if (!test_and_print("clone_state", test_clone_state)) {
+      return 0;
+    }
+    if (!test_and_print("history", test_history)) {
+      return 0;
+    }
+    if (!test_and_print("simulate", test_simulate)) {
+      return 0;
+    }
+    if (!test_and_print("parallel_load", test_parallel_load)) {
+      return 0;
+    }
+    if (!test_and_print("mapped_board", test_mapped_board)) {
+      return 0;
+    }
+    if (!test_and_print("stream_load", test_stream_load)) {
+      return 0;
+    }
+    if (!test_and_print("checkpoint", test_checkpoint)) {
+      return 0;
+    }
+    if (!test_and_print("frame_ring", test_frame_ring)) {
+      return 0;
+    }
+    if (!test_and_print("autopilot", test_autopilot)) {
+      return 0;
+    }
+    if (!test_and_print("components", test_components)) {
+      return 0;
+    }
+    if (!test_and_print("parallel_steal", test_parallel_steal)) {
+      return 0;
+    }
+    if (!test_and_print("replay", test_replay)) {
+      return 0;
+    }
+    if (!test_and_print("fixed_engine", test_fixed_engine)) {
+      return 0;
+    }
+    if (!test_and_print("sparse_board", test_sparse_board)) {
+      return 0;
+    }
+    if (!test_and_print("daemon", test_daemon)) {
+      return 0;
+    }
+    if (!test_and_print("live_snakes", test_live_snakes)) {
+      return 0;
+    }
+    if (!test_and_print("board_check", test_board_check)) {
       return 0;
     }
   }
@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 199506L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frame_ring.h"
+
+/*
+  Spectator for a game published with -p. Attaches to the frame ring read-only and redraws the
+  newest frame whenever it changes, until the game exits.
+*/
+
+void print_frame(frame_t* frame, bool fullscreen) {
+  if (fullscreen) {
+    fprintf(stdout, "\033[2J\033[H");
+  }
+  fwrite(frame->cells, 1, (size_t) (frame->x_size + 1) * frame->y_size, stdout);
+  if (fullscreen) {
+    fprintf(stdout, "frame %llu, tick %llu\n", (unsigned long long) frame->frame,
+            (unsigned long long) frame->timestep);
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+  char* ring_name = "/snake-frames";
+  struct timespec interval = {0, 50000000L};
+  bool once = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i < argc - 1) {
+      ring_name = argv[i + 1];
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "-d") == 0 && i < argc - 1) {
+      double delay = strtod(argv[i + 1], NULL);
+      interval.tv_sec = (time_t) (unsigned int) delay;
+      interval.tv_nsec = (long) (delay * 1000000000) % 1000000000L;
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--once") == 0) {
+      once = true;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s [-p frame ring name] [-d delay] [--once]\n", argv[0]);
+    return 1;
+  }
+
+  frame_ring_t* ring = frame_ring_attach(ring_name);
+  if (ring == NULL) {
+    return 1;
+  }
+
+  frame_t frame;
+  frame.cells = NULL;
+  bool seen = false;
+  uint64_t last = 0;
+  while (true) {
+    // Check before reading, so the last frame is still drawn after the game exits
+    bool closed = frame_ring_closed(ring);
+    if (frame_ring_read(ring, &frame) && (!seen || frame.frame != last)) {
+      print_frame(&frame, !once);
+      seen = true;
+      last = frame.frame;
+      if (once) {
+        break;
+      }
+    }
+    if (closed) {
+      break;
+    }
+    nanosleep(&interval, NULL);
+  }
+
+  free(frame.cells);
+  frame_ring_destroy(ring);
+  return seen ? 0 : 1;
+}